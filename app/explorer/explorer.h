@@ -11,14 +11,26 @@
 #define ITEM_PADDING 4
 #define CONTENT_PADDING 8
 #define MAX_PATH_DEPTH 256
+#define MAX_ROWS 32
+#define NLISTING 4
 
 typedef struct {
 	char name[MAX_SHORT_STRLEN];
 	int is_dir;
-	int widget_id;
-	int y_pos;
+	int is_exec;
 } FileItem;
 
+// A finished directory listing, reused when Explorer comes back to the
+// same path while the directory's generation (stat.gen) is unchanged,
+// i.e. no process has added or removed an entry since.
+typedef struct {
+	char path[MAX_LONG_STRLEN];
+	uint gen;
+	int total;
+	int stamp; // last use, for eviction
+	FileItem *items;
+} Listing;
+
 typedef struct {
 	RGBA color_bg;
 	RGBA color_topbar;
@@ -55,7 +67,15 @@ typedef struct {
 	int dialog_btn2;
 	int dialog_title;
 	int need_refresh;
-	FileItem items[MAX_WIDGET_SIZE];
+	int rows[MAX_ROWS]; // text widgets showing items[top] onwards
+	int nrows;
+	int top;
+	int scanfd; // pipe from the worker listing the directory, or -1
+	int scanpid;
+	FileItem *items; // total_items of them, room for maxitems
+	int maxitems;
+	Listing listings[NLISTING];
+	int stamp;
 	ColorScheme colors;
 } ExplorerState;
 
@@ -95,7 +115,15 @@ void handleKeyboard(Widget *w, message *msg);
 
 // UI functions
 void loadFiles(void);
-void removeAllScrollableWidgets(void);
+void showRows(void);
+void scrollToItem(int idx);
 void initUI(void);
 
+// Directory scanning
+void startScan(int fd, char *path, uint gen);
+void readScan(void);
+void stopScan(void);
+int useListing(char *path, uint gen);
+void forgetListing(char *path);
+
 #endif
\ No newline at end of file
@@ -31,6 +31,7 @@ void confirmNewFolder(Widget *w, message *msg) {
 
 	mkdir(fullPath);
 	clearDialog();
+	forgetListing(state.current_path);
 	state.need_refresh = 1;
 }
 
@@ -73,6 +74,7 @@ void confirmNewFile(Widget *w, message *msg) {
 		close(fd);
 
 	clearDialog();
+	forgetListing(state.current_path);
 	state.need_refresh = 1;
 }
 
@@ -88,14 +90,13 @@ int copyFile(char *src, char *dst) {
 		return -1;
 	}
 
-	char buf[512];
 	int n;
-	while ((n = read(fd_src, buf, sizeof(buf))) > 0) {
-		if (write(fd_dst, buf, n) != n) {
-			close(fd_src);
-			close(fd_dst);
-			return -1;
-		}
+	while ((n = splice(fd_src, fd_dst, 1 << 20)) > 0)
+		;
+	if (n < 0) {
+		close(fd_src);
+		close(fd_dst);
+		return -1;
 	}
 
 	close(fd_src);
@@ -174,5 +175,6 @@ void confirmRename(Widget *w, message *msg) {
 
 	clearDialog();
 	state.selected_index = -1;
+	forgetListing(state.current_path);
 	state.need_refresh = 1;
 }
\ No newline at end of file
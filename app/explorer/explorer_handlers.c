@@ -78,6 +78,7 @@ void handleDelete(Widget *w, message *msg) {
 		}
 
 		unlink(fullPath);
+		forgetListing(state.current_path);
 		state.need_refresh = 1;
 	}
 }
@@ -89,9 +90,9 @@ void handleFileClick(Widget *w, message *msg) {
 	int idx = -1;
 	int wid = findWidgetId(&state.desktop, w);
 
-	for (int i = 0; i < state.total_items; i++) {
-		if (state.items[i].widget_id == wid) {
-			idx = i;
+	for (int i = 0; i < state.nrows; i++) {
+		if (state.rows[i] == wid) {
+			idx = state.top + i;
 			break;
 		}
 	}
@@ -164,8 +165,21 @@ void handleKeyboard(Widget *w, message *msg) {
 		return;
 
 	int key = msg->params[0];
+	int old = state.selected_index;
 
-	if (key == KEY_DN) {
+	if (key == KEY_PGDN || key == KEY_PGUP) {
+		int idx = state.selected_index + (key == KEY_PGDN ? state.nrows : -state.nrows);
+		if (idx >= state.total_items)
+			idx = state.total_items - 1;
+		if (idx < 0)
+			idx = 0;
+		if (state.total_items > 0) {
+			state.selected_index = idx;
+			strcpy(state.selected_name, state.items[idx].name);
+			state.is_selected_dir = state.items[idx].is_dir;
+			state.desktop.needsRepaint = 1;
+		}
+	} else if (key == KEY_DN) {
 		if (state.selected_index < state.total_items - 1) {
 			state.selected_index++;
 			if (state.selected_index >= 0 && state.selected_index < state.total_items) {
@@ -240,4 +254,7 @@ void handleKeyboard(Widget *w, message *msg) {
 			}
 		}
 	}
+
+	if (state.selected_index != old && state.selected_index >= 0)
+		scrollToItem(state.selected_index);
 }
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "explorer.h"
+#include "poll.h"
 #include "user.h"
 
 int main(int argc, char *argv[]) {
@@ -23,10 +24,16 @@ int main(int argc, char *argv[]) {
 	state.dialog_btn2 = -1;
 	state.dialog_title = -1;
 	state.need_refresh = 0;
+	state.scanfd = -1;
 
 	initUI();
 	loadFiles();
 
+	struct pollfd fds[2];
+	fds[0].fd = state.desktop.handler;
+	fds[0].events = POLLIN | POLLWND;
+	fds[1].events = POLLIN;
+
 	while (1) {
 		updateWindow(&state.desktop);
 
@@ -36,7 +43,8 @@ int main(int argc, char *argv[]) {
 		}
 
 		if (!state.dialog_active && state.selected_index >= 0 && state.selected_index < state.total_items) {
-			int y = state.items[state.selected_index].y_pos - state.desktop.scrollOffsetY;
+			int y = TOPBAR_HEIGHT + CONTENT_PADDING +
+				(state.selected_index - state.top) * (ITEM_HEIGHT + ITEM_PADDING);
 
 			int contentTop = TOPBAR_HEIGHT;
 			int contentBottom = state.desktop.height - STATUSBAR_HEIGHT;
@@ -53,6 +61,14 @@ int main(int argc, char *argv[]) {
 					 state.desktop.width - CONTENT_PADDING * 2, ITEM_HEIGHT);
 			}
 		}
+
+		// Sleep until the next message or batch of entries once
+		// everything is painted
+		fds[1].fd = state.scanfd;
+		if (poll(fds, state.scanfd >= 0 ? 2 : 1, state.desktop.needsRepaint ? 0 : -1) < 0)
+			continue;
+		if (state.scanfd >= 0 && (fds[1].revents & (POLLIN | POLLHUP)))
+			readScan();
 	}
 
 	return 0;
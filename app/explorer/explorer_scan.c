@@ -0,0 +1,192 @@
+#include "explorer.h"
+#include "user.h"
+#include "fcntl.h"
+#include "fs.h"
+
+// Directories are listed by a worker process that sends getdents
+// batches down a pipe, so the window keeps serving messages while a big
+// directory is read and the rows fill in as the entries arrive.
+
+#define SCAN_BATCH 32
+
+static char scanbuf[SCAN_BATCH * sizeof(struct dirstat)];
+static int scanlen;
+static char scanpath[MAX_LONG_STRLEN];
+static uint scangen;
+
+// Make room for at least n items, doubling the array; 0 if out of memory.
+static int growItems(int n) {
+	FileItem *items;
+	int max = state.maxitems ? state.maxitems : 64;
+
+	if (n <= state.maxitems)
+		return 1;
+	while (max < n)
+		max *= 2;
+	if ((items = malloc(max * sizeof(FileItem))) == 0)
+		return 0;
+	memmove(items, state.items, state.total_items * sizeof(FileItem));
+	free(state.items);
+	state.items = items;
+	state.maxitems = max;
+	return 1;
+}
+
+// Append directory entry d to the item list if Explorer shows it.
+static void addItem(struct dirstat *d) {
+	char formatName[MAX_SHORT_STRLEN];
+	int nameLen = 0;
+
+	while (nameLen < DIRSIZ && d->name[nameLen])
+		nameLen++;
+	memmove(formatName, d->name, nameLen);
+	formatName[nameLen] = '\0';
+
+	int shouldShow = 0;
+	int isDir = 0;
+	int isExec = 0;
+
+	if (d->type == T_DIR && strcmp(formatName, ".") != 0 && strcmp(formatName, "..") != 0) {
+		shouldShow = 1;
+		isDir = 1;
+	} else if (d->type == T_FILE && shouldShowFile(formatName)) {
+		shouldShow = 1;
+		isDir = 0;
+		isExec = isExecutable(formatName);
+	}
+
+	if (!shouldShow || !growItems(state.total_items + 1))
+		return;
+
+	FileItem *item = &state.items[state.total_items];
+	memmove(item->name, formatName, nameLen + 1);
+	item->is_dir = isDir;
+	item->is_exec = isExec;
+	state.total_items++;
+}
+
+// Keep the finished listing of scanpath, evicting the least recently
+// used one if every slot is taken.
+static void saveListing(void) {
+	Listing *l = &state.listings[0];
+
+	for (int i = 0; i < NLISTING; i++) {
+		if (strcmp(state.listings[i].path, scanpath) == 0) {
+			l = &state.listings[i];
+			break;
+		}
+		if (state.listings[i].stamp < l->stamp)
+			l = &state.listings[i];
+	}
+
+	if (l->items)
+		free(l->items);
+	l->items = malloc(state.total_items * sizeof(FileItem) + 1);
+	if (l->items == 0) {
+		l->path[0] = '\0';
+		return;
+	}
+	memmove(l->items, state.items, state.total_items * sizeof(FileItem));
+	strcpy(l->path, scanpath);
+	l->gen = scangen;
+	l->total = state.total_items;
+	l->stamp = ++state.stamp;
+}
+
+// Fill the items from a kept listing of path; 0 if there is none taken
+// at generation gen of the directory.
+int useListing(char *path, uint gen) {
+	for (int i = 0; i < NLISTING; i++) {
+		Listing *l = &state.listings[i];
+
+		if (l->items && l->gen == gen && strcmp(l->path, path) == 0) {
+			if (!growItems(l->total))
+				return 0;
+			memmove(state.items, l->items, l->total * sizeof(FileItem));
+			state.total_items = l->total;
+			l->stamp = ++state.stamp;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+// Drop the kept listing of path after Explorer changed the directory.
+void forgetListing(char *path) {
+	char openPath[MAX_LONG_STRLEN];
+
+	strcpy(openPath, strlen(path) > 0 ? path : ".");
+	for (int i = 0; i < NLISTING; i++) {
+		if (state.listings[i].items && strcmp(state.listings[i].path, openPath) == 0) {
+			free(state.listings[i].items);
+			state.listings[i].items = 0;
+			state.listings[i].path[0] = '\0';
+		}
+	}
+}
+
+// Start listing directory fd, whose path is path and generation gen. If
+// no worker can be made the directory is read here instead.
+void startScan(int fd, char *path, uint gen) {
+	struct dirstat ds[SCAN_BATCH];
+	int p[2], n;
+
+	strcpy(scanpath, path);
+	scangen = gen;
+	scanlen = 0;
+
+	if (pipe(p) == 0) {
+		if ((state.scanpid = fork()) == 0) {
+			close(p[0]);
+			while ((n = getdents(fd, ds, sizeof(ds), DENT_STAT)) > 0)
+				if (write(p[1], ds, n) != n)
+					break;
+			exit();
+		}
+		close(p[1]);
+		if (state.scanpid > 0) {
+			state.scanfd = p[0];
+			return;
+		}
+		close(p[0]);
+	}
+
+	while ((n = getdents(fd, ds, sizeof(ds), DENT_STAT)) > 0)
+		for (int i = 0; i < n / sizeof(ds[0]); i++)
+			addItem(&ds[i]);
+	saveListing();
+}
+
+// Take the next batch from the worker and show it.
+void readScan(void) {
+	int n = read(state.scanfd, scanbuf + scanlen, sizeof(scanbuf) - scanlen);
+
+	if (n <= 0) {
+		stopScan();
+		if (n == 0)
+			saveListing();
+		return;
+	}
+
+	// the pipe may split a record; keep the tail for the next read
+	scanlen += n;
+	n = scanlen / sizeof(struct dirstat);
+	for (int i = 0; i < n; i++)
+		addItem((struct dirstat *)scanbuf + i);
+	scanlen -= n * sizeof(struct dirstat);
+	memmove(scanbuf, scanbuf + n * sizeof(struct dirstat), scanlen);
+	showRows();
+}
+
+// Stop the worker, if any, and reap it.
+void stopScan(void) {
+	int pid;
+
+	if (state.scanfd < 0)
+		return;
+	kill(state.scanpid);
+	close(state.scanfd);
+	state.scanfd = -1;
+	while ((pid = wait()) >= 0 && pid != state.scanpid)
+		;
+}
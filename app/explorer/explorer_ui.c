@@ -3,30 +3,8 @@
 #include "fcntl.h"
 #include "fs.h"
 
-void removeAllScrollableWidgets() {
-	int toRemove[MAX_WIDGET_SIZE];
-	int removeCount = 0;
-
-	for (int p = state.desktop.widgetlisthead; p != -1; p = state.desktop.widgets[p].next) {
-		if (p >= 0 && p < MAX_WIDGET_SIZE && state.desktop.widgets[p].scrollable == 1) {
-			toRemove[removeCount++] = p;
-			if (removeCount >= MAX_WIDGET_SIZE)
-				break;
-		}
-	}
-
-	for (int i = 0; i < removeCount; i++) {
-		removeWidget(&state.desktop, toRemove[i]);
-	}
-}
-
 void loadFiles() {
-	removeAllScrollableWidgets();
-
-	char pathBuf[MAX_LONG_STRLEN];
-	char *p;
 	int fd;
-	struct dirent de;
 	struct stat st;
 
 	char openPath[MAX_LONG_STRLEN];
@@ -50,108 +28,10 @@ void loadFiles() {
 		return;
 	}
 
-	if (strlen(state.current_path) + 1 + DIRSIZ + 1 > sizeof(pathBuf)) {
-		close(fd);
-		return;
-	}
-
-	strcpy(pathBuf, state.current_path);
-	p = pathBuf + strlen(pathBuf);
-	if (strlen(state.current_path) > 0)
-		*p++ = '/';
-
-	int contentY = TOPBAR_HEIGHT + CONTENT_PADDING;
-	int contentX = CONTENT_PADDING;
-
+	stopScan();
 	state.total_items = 0;
-
-	while (read(fd, &de, sizeof(de)) == sizeof(de)) {
-		if (de.inum == 0)
-			continue;
-
-		memmove(p, de.name, DIRSIZ);
-		p[DIRSIZ] = 0;
-
-		if (stat(pathBuf, &st) < 0)
-			continue;
-
-		char formatName[MAX_SHORT_STRLEN];
-		char *fname = fmtname(pathBuf);
-		if (!fname)
-			continue;
-
-		int nameLen = strlen(fname);
-		if (nameLen >= MAX_SHORT_STRLEN)
-			nameLen = MAX_SHORT_STRLEN - 1;
-
-		memmove(formatName, fname, nameLen);
-		formatName[nameLen] = '\0';
-
-		int shouldShow = 0;
-		int isDir = 0;
-		int isExec = 0;
-
-		if (st.type == T_DIR && strcmp(formatName, ".") != 0 && strcmp(formatName, "..") != 0) {
-			shouldShow = 1;
-			isDir = 1;
-		} else if (st.type == T_FILE && shouldShowFile(formatName)) {
-			shouldShow = 1;
-			isDir = 0;
-			isExec = isExecutable(formatName);
-		}
-
-		if (!shouldShow)
-			continue;
-
-		int y = contentY + state.total_items * (ITEM_HEIGHT + ITEM_PADDING);
-
-		char displayText[MAX_SHORT_STRLEN + 10];
-		RGBA itemColor;
-
-		if (isDir) {
-			strcpy(displayText, "[DIR]  ");
-			if (strlen(displayText) + strlen(formatName) < MAX_SHORT_STRLEN + 10) {
-				strcat(displayText, formatName);
-			}
-			itemColor = state.colors.color_folder;
-		} else if (isExec) {
-			strcpy(displayText, "[EXEC] ");
-			if (strlen(displayText) + strlen(formatName) < MAX_SHORT_STRLEN + 10) {
-				strcat(displayText, formatName);
-			}
-			// Warna hijau untuk executable
-			itemColor.R = 40;
-			itemColor.G = 167;
-			itemColor.B = 69;
-			itemColor.A = 255;
-		} else {
-			strcpy(displayText, "[FILE] ");
-			if (strlen(displayText) + strlen(formatName) < MAX_SHORT_STRLEN + 10) {
-				strcat(displayText, formatName);
-			}
-			itemColor = state.colors.color_file;
-		}
-
-		int wid = addTextWidget(&state.desktop, itemColor, displayText, contentX, y,
-					state.desktop.width - contentX * 2, ITEM_HEIGHT, 1, handleFileClick);
-
-		if (state.total_items < MAX_WIDGET_SIZE) {
-			nameLen = strlen(formatName);
-			if (nameLen >= MAX_SHORT_STRLEN)
-				nameLen = MAX_SHORT_STRLEN - 1;
-
-			memmove(state.items[state.total_items].name, formatName, nameLen);
-			state.items[state.total_items].name[nameLen] = '\0';
-
-			state.items[state.total_items].is_dir = isDir;
-			state.items[state.total_items].widget_id = wid;
-			state.items[state.total_items].y_pos = y;
-			state.total_items++;
-		}
-
-		if (state.total_items >= MAX_WIDGET_SIZE - 10)
-			break;
-	}
+	if (!useListing(openPath, st.gen))
+		startScan(fd, openPath, st.gen);
 
 	close(fd);
 
@@ -171,9 +51,59 @@ void loadFiles() {
 	}
 
 	state.selected_index = -1;
+	state.top = 0;
+	showRows();
+}
+
+// Bind the row widgets to the items from state.top on. Only the rows
+// that fit in the window exist, so a big directory draws no more than
+// a small one.
+void showRows() {
+	for (int i = 0; i < state.nrows; i++) {
+		Text *t = state.desktop.widgets[state.rows[i]].context.text;
+		int idx = state.top + i;
+
+		if (idx >= state.total_items) {
+			t->text[0] = '\0';
+			continue;
+		}
+
+		FileItem *item = &state.items[idx];
+		if (item->is_dir) {
+			strcpy(t->text, "[DIR]  ");
+			t->color = state.colors.color_folder;
+		} else if (item->is_exec) {
+			strcpy(t->text, "[EXEC] ");
+			// Warna hijau untuk executable
+			t->color.R = 40;
+			t->color.G = 167;
+			t->color.B = 69;
+			t->color.A = 255;
+		} else {
+			strcpy(t->text, "[FILE] ");
+			t->color = state.colors.color_file;
+		}
+		strcat(t->text, item->name);
+	}
 	state.desktop.needsRepaint = 1;
 }
 
+// Scroll the list so that item idx is in view.
+void scrollToItem(int idx) {
+	int top = state.top;
+
+	if (idx < top)
+		top = idx;
+	else if (idx >= top + state.nrows)
+		top = idx - state.nrows + 1;
+	if (top < 0)
+		top = 0;
+	if (top != state.top) {
+		state.top = top;
+		showRows();
+	}
+}
+
 void initUI() {
 	addColorFillWidget(&state.desktop, state.colors.color_bg, 0, 0, state.desktop.width,
 			   state.desktop.height, 0, emptyHandler);
@@ -195,6 +125,17 @@ void initUI() {
 						    state.desktop.height - STATUSBAR_HEIGHT,
 						    state.desktop.width, STATUSBAR_HEIGHT, 0, emptyHandler);
 
+	int contentY = TOPBAR_HEIGHT + CONTENT_PADDING;
+	int pitch = ITEM_HEIGHT + ITEM_PADDING;
+	state.nrows = (state.desktop.height - STATUSBAR_HEIGHT - contentY) / pitch;
+	if (state.nrows > MAX_ROWS)
+		state.nrows = MAX_ROWS;
+	for (int i = 0; i < state.nrows; i++) {
+		state.rows[i] = addTextWidget(&state.desktop, state.colors.color_file, "", CONTENT_PADDING,
+					      contentY + i * pitch, state.desktop.width - CONTENT_PADDING * 2,
+					      ITEM_HEIGHT, 0, handleFileClick);
+	}
+
 	addColorFillWidget(&state.desktop, state.colors.color_bg, 0, 0, 0, 0, 0, handleKeyboard);
 	state.desktop.keyfocus = state.desktop.widgetlisttail;
 }
\ No newline at end of file
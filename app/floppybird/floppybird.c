@@ -8,6 +8,7 @@
 #include "user_window.h"
 
 #define columnPairs 3
+#define FRAME_US 30000 // one game step every 30ms
 
 window programWindow;
 int birdId;
@@ -149,10 +150,10 @@ int main() {
 		programWindow.width / 2 - 30, programWindow.height / 2 - 20, 60,
 		40, 0, buttonHandler);
 
-	int startTime = uptime();
+	uint nextFrame = uptimeus();
 
 	while (1) {
-		if (!gameOver && uptime() - startTime > 2) {
+		if (!gameOver && (int)(uptimeus() - nextFrame) >= 0) {
 			for (int i = 0; i < columnPairs; i++) {
 				win_rect *up_position =
 					&programWindow.widgets[columnIds[i]]
@@ -232,8 +233,11 @@ int main() {
 			}
 
 			programWindow.needsRepaint = 1;
-			startTime = uptime();
+			nextFrame += FRAME_US;
+			if ((int)(uptimeus() - nextFrame) > FRAME_US)
+				nextFrame = uptimeus();
 		}
 		updateWindow(&programWindow);
+		usleep(1000);
 	}
 }
\ No newline at end of file
@@ -1,8 +1,10 @@
 #include "character.h"
 #include "fcntl.h"
 #include "gui.h"
+#include "kbd.h"
 #include "memlayout.h"
 #include "msg.h"
+#include "poll.h"
 #include "types.h"
 #include "user.h"
 #include "user_gui.h"
@@ -14,16 +16,39 @@ char *GUI_programs[] = {"terminal", "editor", "explorer", "floppybird",
 
 // Pipe for shell communication
 int sh2gui_fd[2];
-#define READBUFFERSIZE 2000
-char read_buf[READBUFFERSIZE];
+
+// Scrollback: the text of the last SB_BYTES bytes of history in a ring,
+// plus a ring of display lines (already wrapped to the window width)
+// pointing into it. Positions are absolute counts that only grow, so
+// the ring slot is pos % SB_BYTES and lines are dropped once their text
+// has been overwritten. Only the visible rows are ever drawn.
+#define SB_BYTES 65536
+#define SB_LINES 4096
+#define HISTORY_TOP 30
+
+struct sbline {
+	uint start; // absolute byte position of the first character
+	ushort len;
+	ushort prompt; // drawn in promptColor rather than outputColor
+};
+
+char sbText[SB_BYTES];
+struct sbline sbLine[SB_LINES];
+uint sbHead;	   // bytes ever appended
+uint sbLo, sbHi;   // live lines are [sbLo, sbHi)
+int sbOpen;	   // line sbHi - 1 still takes characters
+int sbScroll;	   // lines scrolled back from the bottom
+int sbCols;	   // characters per display line
+int historyRows;   // visible history rows
+int historyRowId[MAX_WIDGET_SIZE]; // text widget of each row
 
 window programWindow;
 int inputWidgetId;  // Input field (fixed bottom)
 int promptWidgetId; // Prompt (fixed bottom)
-int totallines = 0;
 int inputOffset = 25;
 int promptWidth = 70;	   // Lebar area prompt "host$> "
 int bottomAreaHeight = 30; // Area untuk prompt + input di bottom
+int commandRunning = 0;	   // Output of a command is being streamed
 
 // Modern color scheme
 struct RGBA bgColor;
@@ -81,9 +106,8 @@ void panic(char *);
 struct cmd *parsecmd(char *);
 void freecmd(struct cmd *);
 void safestrcpy(char *dst, const char *src, int n);
-void removeAllHistory(void);
 void clearTerminal(void);
-void addToHistory(char *text, struct RGBA color);
+void addToHistory(char *text, int prompt);
 void executeCommand(char *buffer);
 
 void safestrcpy(char *dst, const char *src, int n) {
@@ -225,46 +249,121 @@ int isGUIProgram(char *cmd) {
 	return 0;
 }
 
-// Remove all history widgets (keep fixed widgets: bg, prompt, input)
-void removeAllHistory(void) {
-	int p = programWindow.widgetlisttail;
-	while (p != -1 && p > inputWidgetId) {
-		int prev = programWindow.widgets[p].prev;
-		removeWidget(&programWindow, p);
-		p = prev;
+// Point the history row widgets at the lines currently in view
+void renderHistory(void) {
+	int r, first, i;
+
+	first = sbHi - historyRows - sbScroll;
+	if (first < (int)sbLo)
+		first = sbLo;
+	for (r = 0; r < historyRows; r++) {
+		Text *t = programWindow.widgets[historyRowId[r]].context.text;
+		uint l = first + r;
+
+		t->text[0] = '\0';
+		if (l >= sbHi)
+			continue;
+		struct sbline *ln = &sbLine[l % SB_LINES];
+		for (i = 0; i < ln->len; i++)
+			t->text[i] = sbText[(ln->start + i) % SB_BYTES];
+		t->text[i] = '\0';
+		t->color = ln->prompt ? promptColor : outputColor;
 	}
+	programWindow.needsRepaint = 1;
+}
+
+// Scroll the history by delta lines (positive: back in time)
+void scrollHistory(int delta) {
+	int max = sbHi - sbLo - historyRows;
+
+	sbScroll += delta;
+	if (sbScroll > max)
+		sbScroll = max;
+	if (sbScroll < 0)
+		sbScroll = 0;
+	renderHistory();
 }
 
 // Clear terminal screen
 void clearTerminal(void) {
-	removeAllHistory();
-	totallines = 0;
-	programWindow.scrollOffsetY = 0;
-	programWindow.needsRepaint = 1;
+	sbLo = sbHi = sbHead;
+	sbOpen = 0;
+	sbScroll = 0;
+	renderHistory();
 }
 
-// Add text to history area (scrollable)
-void addToHistory(char *text, struct RGBA color) {
-	int width = programWindow.width - inputOffset * 2;
-	int textLen = strlen(text);
-	int lines = getMouseYFromOffset(text, width, textLen) + 1;
-	int height = lines * CHARACTER_HEIGHT;
+// Append n bytes of text to the scrollback without redrawing
+void appendHistory(char *text, int n, int prompt) {
+	struct sbline *ln;
+	int i;
 
-	// Y position: start from top with margin
-	int yPos = 30 + (totallines * CHARACTER_HEIGHT);
+	for (i = 0; i < n; i++) {
+		if (!sbOpen || (text[i] != '\n' &&
+				sbLine[(sbHi - 1) % SB_LINES].len == sbCols)) {
+			if (sbHi - sbLo == SB_LINES)
+				sbLo++;
+			ln = &sbLine[sbHi++ % SB_LINES];
+			ln->start = sbHead;
+			ln->len = 0;
+			ln->prompt = prompt;
+			sbOpen = 1;
+			if (sbScroll > 0)
+				sbScroll++; // keep the view where it was
+		}
+		if (text[i] == '\n') {
+			sbOpen = 0;
+			continue;
+		}
+		sbText[sbHead++ % SB_BYTES] = text[i];
+		sbLine[(sbHi - 1) % SB_LINES].len++;
+	}
+
+	// Forget lines whose text has been overwritten
+	while (sbLo < sbHi && sbHead - sbLine[sbLo % SB_LINES].start > SB_BYTES)
+		sbLo++;
+	if (sbScroll > (int)(sbHi - sbLo))
+		sbScroll = sbHi - sbLo;
+}
 
-	addTextWidget(&programWindow, color, text, inputOffset, yPos, width,
-		      height, 1, emptyHandler);
+// Add a complete entry to the history and show it
+void addToHistory(char *text, int prompt) {
+	appendHistory(text, strlen(text), prompt);
+	if (sbOpen)
+		appendHistory("\n", 1, 0);
+	renderHistory();
+}
 
-	totallines += lines;
+// Show a command's output as it arrives while still serving window
+// messages, so the terminal keeps repainting during long commands.
+void streamOutput(int fd) {
+	struct pollfd fds[2];
+	char buf[1024];
+	int n;
+
+	fds[0].fd = fd;
+	fds[0].events = POLLIN;
+	fds[1].fd = programWindow.handler;
+	fds[1].events = POLLIN | POLLWND;
+
+	commandRunning = 1;
+	for (;;) {
+		if (poll(fds, 2, programWindow.needsRepaint ? 0 : -1) < 0)
+			break;
+		if ((fds[1].revents & POLLIN) || programWindow.needsRepaint)
+			updateWindow(&programWindow);
+		if (!(fds[0].revents & (POLLIN | POLLHUP)))
+			continue;
 
-	// Auto-scroll to show latest history
-	int totalContentHeight = 30 + (totallines * CHARACTER_HEIGHT);
-	int visibleHeight = programWindow.height - bottomAreaHeight - 30;
-	if (totalContentHeight > visibleHeight) {
-		programWindow.scrollOffsetY =
-			totalContentHeight - visibleHeight;
+		if ((n = read(fd, buf, sizeof(buf))) <= 0)
+			break;
+		appendHistory(buf, n, 0);
+		renderHistory();
 	}
+	if (sbOpen) {
+		appendHistory("\n", 1, 0);
+		renderHistory();
+	}
+	commandRunning = 0;
 }
 
 // Execute command and handle output
@@ -275,6 +374,17 @@ void executeCommand(char *buffer) {
 		return;
 	}
 
+	// Add command to history (with prompt style)
+	char historyLine[MAX_LONG_STRLEN];
+	strcpy(historyLine, "host$> ");
+	int promptLen = strlen(historyLine);
+	int cmdLen = strlen(buffer);
+	if (promptLen + cmdLen < MAX_LONG_STRLEN - 1) {
+		strcpy(historyLine + promptLen, buffer);
+	}
+
+	addToHistory(historyLine, 1);
+
 	int isGUI = isGUIProgram(buffer);
 	int pipe_fds[2] = {-1, -1};
 
@@ -307,45 +417,13 @@ void executeCommand(char *buffer) {
 		exit();
 	} else {
 		// Parent
-		memset(read_buf, 0, READBUFFERSIZE);
-
 		if (!isGUI && pipe_fds[0] >= 0) {
 			close(pipe_fds[1]);
-			int n, totalRead = 0;
-			char tempBuf[256];
-
-			while (totalRead < READBUFFERSIZE - 256) {
-				n = read(pipe_fds[0], tempBuf, 255);
-				if (n <= 0)
-					break;
-				tempBuf[n] = '\0';
-				if (totalRead + n < READBUFFERSIZE - 1) {
-					memmove(read_buf + totalRead, tempBuf,
-						n);
-					totalRead += n;
-					read_buf[totalRead] = '\0';
-				}
-			}
+			streamOutput(pipe_fds[0]);
 			close(pipe_fds[0]);
 		}
 		wait();
 	}
-
-	// Add command to history (with prompt style)
-	char historyLine[MAX_LONG_STRLEN];
-	strcpy(historyLine, "host$> ");
-	int promptLen = strlen(historyLine);
-	int cmdLen = strlen(buffer);
-	if (promptLen + cmdLen < MAX_LONG_STRLEN - 1) {
-		strcpy(historyLine + promptLen, buffer);
-	}
-
-	addToHistory(historyLine, promptColor);
-
-	// Add output if exists
-	if (strlen(read_buf) > 0) {
-		addToHistory(read_buf, outputColor);
-	}
 }
 
 // Input handler
@@ -362,13 +440,16 @@ void inputHandler(Widget *w, message *msg) {
 		int c = msg->params[0];
 		char buffer[MAX_LONG_STRLEN];
 
-		if (c == '\n') {
+		if (c == KEY_PGUP || c == KEY_PGDN) {
+			scrollHistory(c == KEY_PGUP ? historyRows - 1
+						    : 1 - historyRows);
+		} else if (c == '\n') {
 			// Copy command
 			safestrcpy(buffer, w->context.inputfield->text,
 				   MAX_LONG_STRLEN);
 
-			// Skip if empty
-			if (strlen(buffer) == 0) {
+			// Skip if empty or a command is still running
+			if (strlen(buffer) == 0 || commandRunning) {
 				return;
 			}
 
@@ -376,8 +457,7 @@ void inputHandler(Widget *w, message *msg) {
 			executeCommand(buffer);
 
 			// Clear input field
-			w->context.inputfield->text[0] = '\0';
-			w->context.inputfield->current_pos = 0;
+			inputFieldSetText(w->context.inputfield, "");
 
 			programWindow.needsRepaint = 1;
 
@@ -389,10 +469,7 @@ void inputHandler(Widget *w, message *msg) {
 
 			// Auto-grow height if multiline
 			int textLines =
-				getMouseYFromOffset(
-					w->context.inputfield->text, width,
-					strlen(w->context.inputfield->text)) +
-				1;
+				inputFieldRows(w->context.inputfield, width);
 			int newHeight = textLines * CHARACTER_HEIGHT;
 			int maxInputHeight = bottomAreaHeight - 5;
 			if (newHeight > CHARACTER_HEIGHT &&
@@ -448,6 +525,17 @@ int main(int argc, char *argv[]) {
 			   programWindow.width, bottomAreaHeight, 0,
 			   emptyHandler);
 
+	// One text widget per visible history row
+	historyRows = (programWindow.height - bottomAreaHeight - HISTORY_TOP) /
+		      CHARACTER_HEIGHT;
+	sbCols = width / CHARACTER_WIDTH;
+	for (int r = 0; r < historyRows; r++) {
+		historyRowId[r] = addTextWidget(
+			&programWindow, outputColor, "", inputOffset,
+			HISTORY_TOP + r * CHARACTER_HEIGHT, width,
+			CHARACTER_HEIGHT, 0, emptyHandler);
+	}
+
 	// Create prompt widget (fixed bottom)
 	int bottomY = programWindow.height - bottomAreaHeight;
 	promptWidgetId = addTextWidget(&programWindow, promptColor, "host$>",
@@ -462,8 +550,15 @@ int main(int argc, char *argv[]) {
 
 	printf(1, "Terminal started\n");
 
+	struct pollfd wfd;
+	wfd.fd = programWindow.handler;
+	wfd.events = POLLIN | POLLWND;
+
+	// Sleep until the next message once everything is painted
 	while (1) {
 		updateWindow(&programWindow);
+		if (!programWindow.needsRepaint)
+			poll(&wfd, 1, -1);
 	}
 
 	return 0;
@@ -9,11 +9,13 @@ struct context;
 struct file;
 struct inode;
 struct pipe;
+struct pollfd;
 struct proc;
 struct rtcdate;
 struct spinlock;
 struct sleeplock;
 struct stat;
+struct lockstat;
 struct superblock;
 
 struct RGB;
@@ -23,6 +25,7 @@ struct message;
 // window_manager.c
 void wmInit(void);
 void wmHandleMessage(struct message *);
+int wmpoll(int);
 
 // msg.c
 int handleMessage(struct message *);
@@ -33,7 +36,9 @@ extern ushort SCREEN_WIDTH;
 extern ushort SCREEN_HEIGHT;
 extern struct RGB *screen;
 extern struct RGB *screen_buf;
+extern uint guimemsize;
 void initGUI(void);
+void fbflush(void);
 int drawCharacter(struct RGB *, int, int, char, struct RGBA);
 int drawIcon(struct RGB *buf, int x, int y, int icon, struct RGBA color);
 void drawString(struct RGB *, int, int, char *, struct RGBA);
@@ -55,6 +60,7 @@ void drawRectBorder(struct RGB *buf, struct RGB color, int x, int y, int width,
 // bio.c
 void binit(void);
 struct buf *bread(uint, uint);
+struct buf *bnew(uint, uint);
 void brelse(struct buf *);
 void bwrite(struct buf *);
 
@@ -71,15 +77,28 @@ int exec(char *, char **);
 struct file *filealloc(void);
 void fileclose(struct file *);
 struct file *filedup(struct file *);
+struct file *fileget(int);
 void fileinit(void);
 int fileread(struct file *, char *, int n);
 int filestat(struct file *, struct stat *);
 int filewrite(struct file *, char *, int n);
+int filesplice(struct file *, struct file *, int n);
+int filepoll(struct file *, int);
+int filegetdents(struct file *, char *, int, int);
+void pollwakeup(void);
+int pollwait(struct pollfd *, int, int);
+
+// futex.c
+void futexinit(void);
+int futexwait(uint, int);
+int futexwake(uint, int);
 
 // fs.c
 void readsb(int dev, struct superblock *sb);
 int dirlink(struct inode *, char *, uint);
 struct inode *dirlookup(struct inode *, char *, uint *);
+int dirread(struct inode *, uint *, char *, int, int);
+void dirunlink(struct inode *, uint);
 struct inode *ialloc(uint, short);
 struct inode *idup(struct inode *);
 void iinit(int dev);
@@ -110,6 +129,7 @@ char *kalloc(void);
 void kfree(char *);
 void kinit1(void *, void *);
 void kinit2(void *, void *);
+uint kmempages(void);
 
 // kbd.c
 void kbdintr(void);
@@ -124,7 +144,9 @@ int lapicid(void);
 extern volatile uint *lapic;
 void lapiceoi(void);
 void lapicinit(void);
+void lapicipi(int, int);
 void lapicstartap(uchar, uint);
+void lapictimer(uint);
 void microdelay(int);
 
 // log.c
@@ -141,19 +163,29 @@ void mpinit(void);
 void picenable(int);
 void picinit(void);
 
+// mmap.c
+int mmapfault(uint, int);
+int mmapcheck(uint, int, int);
+int mmapfork(struct proc *, struct proc *);
+void mmapclose(struct proc *);
+
 // pipe.c
 int pipealloc(struct file **, struct file **);
 void pipeclose(struct pipe *, int);
 int piperead(struct pipe *, char *, int);
 int pipewrite(struct pipe *, char *, int);
+int pipepoll(struct pipe *, int);
 
 // PAGEBREAK: 16
 // proc.c
+int clone(uint, uint, uint, int);
 int cpuid(void);
 void exit(void);
 int fork(void);
 int growproc(int);
+int join(uint *);
 int kill(int);
+void killthreads(void);
 struct cpu *mycpu(void);
 struct proc *myproc();
 void pinit(void);
@@ -161,6 +193,7 @@ void procdump(void);
 void scheduler(void) __attribute__((noreturn));
 void sched(void);
 void setproc(struct proc *);
+int sharedvm(void);
 void sleep(void *, struct spinlock *);
 void userinit(void);
 int wait(void);
@@ -175,6 +208,8 @@ void acquire(struct spinlock *);
 void getcallerpcs(void *, uint *);
 int holding(struct spinlock *);
 void initlock(struct spinlock *, char *);
+void initticketlock(struct spinlock *, char *);
+int lockstats(struct lockstat *, int);
 void release(struct spinlock *);
 void pushcli(void);
 void popcli(void);
@@ -197,13 +232,23 @@ char *strncpy(char *, const char *, int);
 // syscall.c
 int argint(int, int *);
 int argptr(int, char **, int);
+int arginptr(int, char **, int);
 int argstr(int, char **);
 int fetchint(uint, int *);
 int fetchstr(uint, char **);
 void syscall(void);
 
 // timer.c
+void hrarm(struct proc *, uint64, void *);
+void hrcancel(struct proc *);
+uint64 hrcycles(uint);
+int hrsleep(uint64);
+uint64 hrtime(void);
+uint hrusec(uint64);
+uint tickupdate(void);
+void timerarm(void);
 void timerinit(void);
+void timerintr(void);
 
 // trap.c
 void idtinit(void);
@@ -231,6 +276,10 @@ void switchuvm(struct proc *);
 void switchkvm(void);
 int copyout(pde_t *, uint, void *, uint);
 void clearpteu(pde_t *pgdir, char *uva);
+uint *walkpgdir(pde_t *, const void *, int);
+int mappages(pde_t *, void *, uint, uint, int);
+void fbmapwc(uint, uint);
+void patinit(void);
 
 // rtc.c
 void            rtc_init(void);
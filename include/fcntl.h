@@ -6,4 +6,11 @@
 #define O_RDWR 0x002
 #define O_CREATE 0x200
 
+// getdents() flags
+#define DENT_STAT 0x1
+
+// mmap() protection; mappings are always private
+#define PROT_READ 0x1
+#define PROT_WRITE 0x2
+
 #endif // FCNTL_H
\ No newline at end of file
@@ -20,6 +20,9 @@ struct inode {
 	uint dev;	       // Device number
 	uint inum;	       // Inode number
 	int ref;	       // Reference count
+	struct inode *hnext;   // icache hash chain
+	struct inode *prev;    // icache LRU list, while ref == 0
+	struct inode *next;
 	struct sleeplock lock; // protects everything below here
 	int valid;	       // inode has been read from disk?
 
@@ -28,7 +31,16 @@ struct inode {
 	short minor;
 	short nlink;
 	uint size;
-	uint addrs[NDIRECT + 1];
+	uint flags; // DI_* block map format
+	ushort hlevel; // DI_DIRHASH directory index state
+	ushort hsplit;
+	uint hovfl;
+	uint gen;
+	uint addrs[NDIRECT + 2];
+
+	uint rsv_next; // reservation window [rsv_next, rsv_end) for
+	uint rsv_end;  // contiguous allocation; see dalloc() in fs.c
+	struct inode *rsv_link; // next non-empty window, by start block
 };
 
 // table mapping major device number to
@@ -36,6 +48,7 @@ struct inode {
 struct devsw {
 	int (*read)(struct inode *, char *, int);
 	int (*write)(struct inode *, char *, int);
+	int (*poll)(struct inode *); // POLLIN/POLLOUT, or 0 if not provided
 };
 
 extern struct devsw devsw[];
@@ -15,8 +15,13 @@ struct superblock {
   uint inodestart;   // First inode block
   uint bmapstart;    // First free map block
   uint checksum;     // Fletcher-32 Checksum integritas metadata
+  uint features;     // FS_* feature flags set by mkfs
 };
 
+// Superblock feature flags
+#define FS_EXTENTS 0x1 // new regular files are extent-mapped
+#define FS_DIRHASH 0x2 // new directories are hash-indexed
+
 #define NDIRECT 10
 #define NINDIRECT (BSIZE / sizeof(uint))
 #define NDINDIRECT (NINDIRECT * NINDIRECT)
@@ -33,8 +38,36 @@ struct dinode_core {
   uint atime;           // Access time
   uint mtime;           // Modified time
   uint ctime;           // Creation time
+  uint flags;           // DI_* block map format flags
+  ushort hlevel;        // DI_DIRHASH: linear hashing level
+  ushort hsplit;        // DI_DIRHASH: next bucket to split
+  uint hovfl;           // DI_DIRHASH: entries stored outside their bucket
+  uint gen;             // Directory: bumped by every entry added or removed
+};
+
+// Inode format flags
+#define DI_EXTENTS 0x1 // addrs[] holds extents instead of block pointers
+#define DI_DIRHASH 0x2 // directory blocks are hash buckets (see fs.c)
+
+// Extent-mapped inodes reuse addrs[]: the first NIEXTENT (start, len)
+// runs live inline, and addrs[XEXTBLK] points to an index block of up
+// to NXINDEX extent blocks, each holding NXEXTENT more runs. Extents are
+// kept in file order; a zero len (or a zero index blk) ends the list.
+struct extent {
+  uint start;           // First disk block of the run
+  uint len;             // Number of blocks in the run
+};
+
+struct xindex {
+  uint fbn;             // File block mapped by the extent block's first run
+  uint blk;             // Disk block holding the extents
 };
 
+#define NIEXTENT (NDIRECT / 2)
+#define XEXTBLK (NDIRECT + 1)
+#define NXEXTENT (BSIZE / sizeof(struct extent))
+#define NXINDEX (BSIZE / sizeof(struct xindex))
+
 // Union memastikan secara matematis ukuran struct adalah 128 byte
 struct dinode {
   union {
@@ -50,6 +83,15 @@ struct dirent {
   ushort inum;
   char name[DIRSIZ];
 };
+
+// Entry returned by getdents() with DENT_STAT: a dirent plus the type
+// and size of the inode it names.
+struct dirstat {
+  ushort inum;
+  short type;
+  uint size;
+  char name[DIRSIZ];
+};
 // ----------------------------------------------------
 
 #define IPB           (BSIZE / sizeof(struct dinode))
@@ -0,0 +1,18 @@
+#ifndef LOCKSTAT_H
+#define LOCKSTAT_H
+
+#include "types.h"
+
+// Contention statistics for all spinlocks sharing a name, as returned by
+// the lockstat() system call. Gathered only by a kernel built with
+// make LOCKSTAT=1.
+struct lockstat {
+	char name[16];
+	uint nacquire;	   // acquisitions
+	uint ncontend;	   // acquisitions that found the lock held
+	uint nspin;	   // pause iterations spent waiting
+	uint hold_max;	   // longest hold, in TSC cycles
+	uint hold_kcycles; // total hold time, in units of 1024 TSC cycles
+};
+
+#endif // LOCKSTAT_H
@@ -7,6 +7,7 @@
 // Key addresses for address space layout (see kmap in vm.c for layout)
 #define KERNBASE 0x80000000	     // First kernel virtual address
 #define KERNLINK (KERNBASE + EXTMEM) // Address where kernel is linked
+#define MMAPBASE 0x40000000	     // mmap() regions; the heap stays below
 
 #define V2P(a) (((uint)(a)) - KERNBASE)
 #define P2V(a) ((void *)(((char *)(a)) + KERNBASE))
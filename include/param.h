@@ -4,15 +4,23 @@
 #define NPROC        64        // Maximum number of processes
 #define KSTACKSIZE   4096      // Size of per-process kernel stack
 #define NCPU         8         // Maximum number of CPUs
+#define TICKUS       10000     // Microseconds per scheduling tick
+#define NVMA         16        // Memory-mapped regions per process
 #define NOFILE       64        // Open files per process (increased for game assets)
 #define NFILE        100       // Open files per system
-#define NINODE       100       // Maximum number of active i-nodes (increased for icons/WADs)
+#define NINODE       100       // Minimum size of the in-memory inode cache
+#define IMEMPER      65536     // Bytes of physical memory per cached inode
+#define NIHASH       127       // Inode cache hash buckets
+#define NDCACHE      256       // Entries in the path-name lookup cache
+#define PIPEPAGES    4         // Pages of ring buffer per pipe
 #define NDEV         10        // Maximum major device number
 #define ROOTDEV      1         // Device number of file system root disk
 #define MAXARG       32        // Max exec arguments
-#define MAXOPBLOCKS  10        // Max # of blocks any FS op writes
-#define LOGSIZE      (MAXOPBLOCKS * 3) // Max data blocks in on-disk log
-#define NBUF         (MAXOPBLOCKS * 3) // Size of disk block cache
+#define MAXOPBLOCKS  32        // Max # of blocks any FS op writes
+#define LOGSIZE      (MAXOPBLOCKS * 3 + 1) // Default on-disk log blocks (header + data), see mkfs -l
+#define NBUF         (MAXOPBLOCKS * 4) // Size of disk block cache
+#define NRSVBLOCK    64        // Blocks reserved ahead for a growing file
+#define LOGMAX       (NBUF - MAXOPBLOCKS) // Max data blocks the kernel logs per commit
 
 // File System Configuration for ~50 MB Disk
 // Calculation: (50 * 1024 * 1024) / 2048 (BSIZE) = 25,600 blocks
@@ -0,0 +1,17 @@
+#ifndef POLL_H
+#define POLL_H
+
+// poll() events
+#define POLLIN 0x001   // data to read, or a window message queued
+#define POLLOUT 0x004  // room to write
+#define POLLHUP 0x010  // the other end is closed
+#define POLLNVAL 0x020 // not an open descriptor or owned window
+#define POLLWND 0x100  // fd is a window handle, not a file descriptor
+
+struct pollfd {
+	int fd;
+	short events;
+	short revents;
+};
+
+#endif // POLL_H
@@ -3,6 +3,7 @@
 
 #include "mmu.h"
 #include "param.h"
+#include "sleeplock.h"
 #include "types.h"
 
 // Per-CPU state
@@ -15,6 +16,7 @@ struct cpu {
 	int ncli;		   // Depth of pushcli nesting.
 	int intena;		   // Were interrupts enabled before pushcli?
 	struct proc *proc;	   // The process running on this cpu or null
+	volatile int idle;	   // Halted in scheduler; wake with an IPI
 };
 
 extern struct cpu cpus[NCPU];
@@ -29,6 +31,24 @@ struct context {
 	uint eip;
 };
 
+// A memory-mapped file region [start, end), page aligned; see mmap.c
+struct vma {
+	uint start;
+	uint end;
+	uint off;     // file offset of start
+	int prot;     // PROT_READ | PROT_WRITE
+	struct file *f; // 0 if the slot is free
+};
+
+// Open files and current directory, shared by a process and its
+// threads; see filesdup() in proc.c.
+struct files {
+	struct spinlock lock;	    // protects ofile[] and cwd
+	int ref;		    // procs using this; under the ptable lock
+	struct file *ofile[NOFILE]; // Open files
+	struct inode *cwd;	    // Current directory
+};
+
 enum procstate { UNUSED, EMBRYO, SLEEPING, RUNNABLE, RUNNING, ZOMBIE };
 
 // Per-process state
@@ -43,9 +63,14 @@ struct proc {
 	struct context *context;    // swtch() here to run process
 	void *chan;		    // If non-zero, sleeping on chan
 	int killed;		    // If non-zero, have been killed
-	struct file *ofile[NOFILE]; // Open files
-	struct inode *cwd;	    // Current directory
+	struct files *files;	    // Open files and current directory
 	char name[16];		    // Process name (debugging)
+	struct vma vma[NVMA];	    // Memory-mapped files
+	uint64 wakeat;		    // hrtimer deadline, in TSC cycles
+	void *wakechan;		    // Woken at wakeat; 0 for poll()
+	struct proc *leader;	    // Owns pgdir and vma; self unless a thread
+	struct sleeplock vmlock;    // Leader's: serializes changes to pgdir, sz, vma
+	uint ustack;		    // Thread's user stack, returned by join()
 };
 
 #endif // PROC_H
\ No newline at end of file
@@ -7,11 +7,21 @@
 struct spinlock {
 	uint locked; /* Is the lock held? */
 
-	/* For debugging: */
+	/* Ticket locks (initticketlock) are granted in FIFO order: */
+	int fair;	     /* Use next/owner instead of spinning on locked. */
+	ushort next;	     /* Next ticket to hand out. */
+	ushort owner;	     /* Ticket being served. */
+
 	char *name;	 /* Name of lock. */
 	struct cpu *cpu; /* The cpu holding the lock. */
-	uint pcs[10];	 /* The call stack (an array of program counters)
-			    that locked the lock. */
+#ifdef LOCKSTAT
+	struct lockclass *stat;	 /* Statistics shared by locks of this name. */
+	unsigned long long tacq; /* TSC when acquired. */
+#endif
+#ifdef LOCKDEBUG
+	uint pcs[10]; /* The call stack (an array of program counters)
+			 that locked the lock. */
+#endif
 };
 
 #endif
\ No newline at end of file
@@ -13,6 +13,7 @@ struct stat {
 	uint ino;    // Inode number
 	short nlink; // Number of links to file
 	uint size;   // Size of file in bytes
+	uint gen;    // Directory: changes whenever an entry is added or removed
 };
 
 #endif
\ No newline at end of file
@@ -37,5 +37,17 @@
 #define SYS_reboot 33
 #define SYS_get_rtc_time 34
 #define SYS_get_rtc_date 35
+#define SYS_splice 36
+#define SYS_mmap 37
+#define SYS_munmap 38
+#define SYS_poll 39
+#define SYS_lockstat 40
+#define SYS_usleep 41
+#define SYS_uptimeus 42
+#define SYS_getdents 43
+#define SYS_clone 44
+#define SYS_join 45
+#define SYS_futexwait 46
+#define SYS_futexwake 47
 
 #endif
\ No newline at end of file
@@ -0,0 +1,19 @@
+#ifndef TEXTBUF_H
+#define TEXTBUF_H
+
+// Editable text kept as a gap buffer, with an index of line starts.
+//
+// The text lives in text[0..gap) and text[gapend..cap); inserting or
+// deleting at the gap is O(1), and moving the gap costs the distance
+// moved. The line index is split the same way: line[0..lgap) holds
+// the starts of lines at or before the gap as offsets, and
+// line[lgapend..lcap) holds the later ones as distances from the end
+// of the text, so edits at the gap never have to touch either half.
+struct textbuf {
+	char *text;
+	int cap, gap, gapend;
+	int *line;
+	int lcap, lgap, lgapend;
+};
+
+#endif // TEXTBUF_H
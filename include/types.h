@@ -3,6 +3,7 @@
 
 #ifndef __ASSEMBLER__
 typedef unsigned int uint;
+typedef unsigned long long uint64;
 typedef unsigned short ushort;
 typedef unsigned char uchar;
 typedef uint pde_t;
@@ -0,0 +1,27 @@
+#ifndef ULOCK_H
+#define ULOCK_H
+
+// Sleeping locks for threads, built on futexwait()/futexwake().
+// Each keeps enough state in user memory that the uncontended cases
+// take and release it with one atomic instruction, without a system
+// call; only a thread that has to wait, or has to wake one, enters
+// the kernel.
+
+// state is 0 when free, 1 when held, 2 when held and maybe waited on.
+struct mutex {
+	volatile uint state;
+};
+
+// Waiters sleep on seq, which every signal bumps; waiters counts
+// them so signals with nobody waiting stay in user space.
+struct cond {
+	volatile uint seq;
+	volatile uint waiters;
+};
+
+struct sem {
+	volatile uint count;
+	volatile uint waiters;
+};
+
+#endif // ULOCK_H
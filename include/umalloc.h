@@ -0,0 +1,15 @@
+#ifndef UMALLOC_H
+#define UMALLOC_H
+
+// A snapshot of the heap filled in by heapstat(), in bytes: heap is
+// slabs + large + free, and the small objects live in the slabs,
+// counted at their class size.
+struct heapstat {
+	uint heap;  // taken from sbrk() and not given back
+	uint slabs; // pages cut into small objects
+	uint small; // small objects in use
+	uint large; // pages of large objects in use
+	uint free;  // free pages
+};
+
+#endif // UMALLOC_H
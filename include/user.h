@@ -9,7 +9,10 @@ struct RGBA;
 struct RGB;
 struct message;
 struct Widget;
+struct InputField;
 struct window;
+struct pollfd;
+struct lockstat;
 
 typedef void (*Handler)(struct Widget *, struct message *);
 
@@ -52,6 +55,30 @@ int reboot(void);
 int get_rtc_time(int *hours, int *minutes, int *seconds);
 int get_rtc_date(int *day, int *month, int *year);
 
+// Move up to n bytes from fd in to fd out without a user-space copy
+int splice(int, int, int);
+
+// Map len bytes of fd from page-aligned offset off, privately
+char *mmap(int fd, int off, int len, int prot);
+int munmap(char *, int);
+
+// Wait up to timeout ticks (-1: forever) for fds or window handles
+int poll(struct pollfd *, int, int);
+
+// Copy up to n spinlock statistics entries; -1 without LOCKSTAT
+int lockstat(struct lockstat *, int);
+
+// Sleep for n microseconds; microseconds since boot, modulo 2^32
+int usleep(int);
+uint uptimeus(void);
+int getdents(int, void *, int, int);
+int clone(void (*)(void *), void *, void *, int);
+int join(void **);
+
+// Sleep while *addr == val; wake up to n sleepers on addr
+int futexwait(volatile uint *, int);
+int futexwake(volatile uint *, int);
+
 // ulib.c
 int stat(const char *, struct stat *);
 char *strcpy(char *, const char *);
@@ -65,8 +92,47 @@ uint strlen(const char *);
 void *memset(void *, int, uint);
 void *malloc(uint);
 void free(void *);
+struct heapstat;
+void heapstat(struct heapstat *);
 int atoi(const char *);
 
+// thread.c
+int thread_create(void (*)(void *), void *);
+int thread_join(void);
+
+// ulock.c
+struct mutex;
+struct cond;
+struct sem;
+void mutex_init(struct mutex *);
+void mutex_lock(struct mutex *);
+int mutex_trylock(struct mutex *);
+void mutex_unlock(struct mutex *);
+void cond_init(struct cond *);
+void cond_wait(struct cond *, struct mutex *);
+void cond_signal(struct cond *);
+void cond_broadcast(struct cond *);
+void sem_init(struct sem *, int);
+void sem_wait(struct sem *);
+int sem_trywait(struct sem *);
+void sem_post(struct sem *);
+
+// textbuf.c
+struct textbuf;
+int tbinit(struct textbuf *);
+void tbfree(struct textbuf *);
+void tbclear(struct textbuf *);
+int tblen(struct textbuf *);
+int tbnlines(struct textbuf *);
+int tbchar(struct textbuf *, int);
+int tblinestart(struct textbuf *, int);
+int tblinelen(struct textbuf *, int);
+int tblineof(struct textbuf *, int);
+int tbinsert(struct textbuf *, int, char *, int);
+int tbdelete(struct textbuf *, int);
+int tbread(struct textbuf *, int);
+int tbwrite(struct textbuf *, int);
+
 // user_window.c
 void debugPrintWidgetList(struct window *win);
 void createPopupWindow(struct window *, int);
@@ -82,6 +148,8 @@ int addTextWidget(struct window *win, struct RGBA c, char *text, int x, int y,
 		  int w, int h, int, Handler handler);
 int addInputFieldWidget(struct window *win, struct RGBA c, char *text, int x,
 			int y, int w, int h, int, Handler handler);
+int addTextAreaWidget(struct window *win, struct RGBA c, int x, int y, int w,
+		      int h, int, Handler handler);
 int addColorFillWidget(struct window *win, struct RGBA c, int x, int y, int w,
 		       int h, int, Handler handler);
 int addRectangleWidget(struct window *win, struct RGBA c,
@@ -98,6 +166,8 @@ void drawRect(struct window *win, struct RGB color, int x, int y, int width,
 	      int height);
 void drawFillRect(struct window *win, struct RGBA color, int x, int y,
 		  int width, int height);
+int drawCharacter(struct RGB *buf, int x, int y, char ch, struct RGBA color,
+		  int win_width, int win_height);
 void drawString(struct window *win, char *str, struct RGBA color, int x, int y,
 		int width, int height);
 void draw24Image(struct window *win, struct RGB *img, int x, int y, int width,
@@ -113,6 +183,11 @@ int getMouseXFromOffset(char *str, int width, int offset);
 int getMouseYFromOffset(char *str, int width, int offset);
 void inputMouseLeftClickHandler(struct Widget *w, struct message *msg);
 void inputFieldKeyHandler(struct Widget *w, struct message *msg);
+void inputFieldSetText(struct InputField *f, char *text);
+int inputFieldRows(struct InputField *f, int width);
+int inputFieldCursor(struct InputField *f, int width, int *col);
+void textAreaClickHandler(struct Widget *w, struct message *msg);
+void textAreaKeyHandler(struct Widget *w, struct message *msg);
 int getScrollableTotalHeight(struct window *win);
 int addScrollBarWidget(struct window *window, struct RGBA color,
 		       Handler handler);
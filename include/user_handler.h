@@ -5,11 +5,15 @@ struct Widget;
 struct message;
 struct window;
 struct RGBA;
+struct InputField;
 
 // Forward declarations for common handlers
 void emptyHandler(struct Widget *w, struct message *msg);
 void inputMouseLeftClickHandler(struct Widget *w, struct message *msg);
 void inputFieldKeyHandler(struct Widget *w, struct message *msg);
+void inputFieldSetText(struct InputField *f, char *text);
+int inputFieldRows(struct InputField *f, int width);
+int inputFieldCursor(struct InputField *f, int width, int *col);
 
 // Utility functions for text positioning
 int getInputOffsetFromMousePosition(char *str, int width, int mouse_x, int mouse_y);
@@ -5,6 +5,7 @@
 #define MAX_LONG_STRLEN 1000
 
 #include "gui.h"
+#include "textbuf.h"
 #include "window_manager.h"
 
 #define KEY_HOME 0xE0
@@ -30,6 +31,7 @@ typedef void (*Handler)(struct Widget *widget, struct message *msg);
 #define COLORFILL 4
 #define SHAPE 5
 #define IMAGE 6
+#define TEXTAREA 7
 
 #define RECTANGLE 0
 #define LINE 1
@@ -58,12 +60,26 @@ typedef struct Text {
 	char text[MAX_LONG_STRLEN];
 } Text;
 
+// rowstart[i] is the offset of the i-th displayed row of text when
+// wrapped at rowcols columns; rowlen is the text length it was built
+// for, so a text changed behind the handlers' back gets re-indexed.
 typedef struct InputField {
 	struct RGBA color;
 	char text[MAX_LONG_STRLEN];
 	int current_pos;
+	ushort rowstart[MAX_LONG_STRLEN];
+	int nrows, rowcols, rowlen;
 } InputField;
 
+// A multi-line document. top and left are the first line and column
+// shown, kept so that the cursor stays in view.
+typedef struct TextArea {
+	struct RGBA color;
+	struct textbuf tb;
+	int current_pos;
+	int top, left;
+} TextArea;
+
 typedef struct Icon {
 	struct RGBA color;
 	struct RGBA bg_color;
@@ -75,6 +91,7 @@ typedef union widget_base {
 	Button *button;
 	Text *text;
 	InputField *inputfield;
+	TextArea *textarea;
 	Icon *icon;
 	Shape *shape;
 } widget_base;
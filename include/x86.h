@@ -79,6 +79,28 @@ static inline void loadgs(ushort v) {
 	asm volatile("movw %0, %%gs" : : "r"(v));
 }
 
+// Spin-wait hint: lets a sibling hyperthread run and avoids a memory
+// order violation flush when the awaited store arrives.
+static inline void pause(void) { asm volatile("pause"); }
+
+static inline unsigned long long rdtsc(void) {
+	unsigned long long t;
+	asm volatile("rdtsc" : "=A"(t));
+	return t;
+}
+
+static inline void cpuinfo(uint op, uint *a, uint *b, uint *c, uint *d) {
+	asm volatile("cpuid"
+		     : "=a"(*a), "=b"(*b), "=c"(*c), "=d"(*d)
+		     : "a"(op), "c"(0));
+}
+
+static inline void wrmsr(uint msr, uint lo, uint hi) {
+	asm volatile("wrmsr" : : "c"(msr), "a"(lo), "d"(hi));
+}
+
+static inline void wbinvd(void) { asm volatile("wbinvd" : : : "memory"); }
+
 static inline void cli(void) { asm volatile("cli"); }
 
 static inline void sti(void) { asm volatile("sti"); }
@@ -94,6 +116,17 @@ static inline uint xchg(volatile uint *addr, uint newval) {
 	return result;
 }
 
+// Store newval at addr if it holds old; return what addr held.
+static inline uint cmpxchg(volatile uint *addr, uint old, uint newval) {
+	uint result;
+
+	asm volatile("lock; cmpxchgl %2, %1"
+		     : "=a"(result), "+m"(*addr)
+		     : "r"(newval), "0"(old)
+		     : "cc");
+	return result;
+}
+
 static inline uint rcr2(void) {
 	uint val;
 	asm volatile("movl %%cr2,%0" : "=r"(val));
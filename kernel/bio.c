@@ -99,6 +99,16 @@ struct buf *bread(uint dev, uint blockno) {
 	return b;
 }
 
+// Return a locked buf for a block whose contents the caller is about
+// to overwrite completely, without reading it from disk.
+struct buf *bnew(uint dev, uint blockno) {
+	struct buf *b;
+
+	b = bget(dev, blockno);
+	b->flags |= B_VALID;
+	return b;
+}
+
 // Write b's contents to disk.  Must be locked.
 void bwrite(struct buf *b) {
 	if (!holdingsleep(&b->lock))
@@ -8,6 +8,7 @@
 #include "memlayout.h"
 #include "mmu.h"
 #include "param.h"
+#include "poll.h"
 #include "proc.h"
 #include "sleeplock.h"
 #include "spinlock.h"
@@ -214,6 +215,7 @@ void consoleintr(int (*getc)(void)) {
 				    input.e == input.r + INPUT_BUF) {
 					input.w = input.e;
 					wakeup(&input.r);
+					pollwakeup();
 				}
 			}
 			break;
@@ -274,11 +276,22 @@ int consolewrite(struct inode *ip, char *buf, int n) {
 	return n;
 }
 
+int consolepoll(struct inode *ip) {
+	int r = POLLOUT;
+
+	acquire(&cons.lock);
+	if (input.r != input.w)
+		r |= POLLIN;
+	release(&cons.lock);
+	return r;
+}
+
 void consoleinit(void) {
 	initlock(&cons.lock, "console");
 
 	devsw[CONSOLE].write = consolewrite;
 	devsw[CONSOLE].read = consoleread;
+	devsw[CONSOLE].poll = consolepoll;
 	cons.locking = 1;
 
 	ioapicenable(IRQ_KBD, 0);
@@ -17,6 +17,10 @@ int exec(char *path, char **argv) {
 	pde_t *pgdir, *oldpgdir;
 	struct proc *curproc = myproc();
 
+	// Only a process's leader may replace its image.
+	if (curproc->leader != curproc)
+		return -1;
+
 	begin_op();
 
 	if ((ip = namei(path)) == 0) {
@@ -92,6 +96,7 @@ int exec(char *path, char **argv) {
 	safestrcpy(curproc->name, last, sizeof(curproc->name));
 
 	// Commit to the user image.
+	killthreads();
 	oldpgdir = curproc->pgdir;
 	curproc->pgdir = pgdir;
 	curproc->sz = sz;
@@ -99,6 +104,7 @@ int exec(char *path, char **argv) {
 	curproc->tf->esp = sp;
 	switchuvm(curproc);
 	freevm(oldpgdir);
+	mmapclose(curproc);
 	return 0;
 
 bad:
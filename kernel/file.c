@@ -5,9 +5,13 @@
 #include "file.h"
 #include "defs.h"
 #include "fs.h"
+#include "mmu.h"
 #include "param.h"
+#include "poll.h"
+#include "proc.h"
 #include "sleeplock.h"
 #include "spinlock.h"
+#include "stat.h"
 #include "types.h"
 
 struct devsw devsw[NDEV];
@@ -16,7 +20,18 @@ struct {
 	struct file file[NFILE];
 } ftable;
 
-void fileinit(void) { initlock(&ftable.lock, "ftable"); }
+// poll() sleepers wait on gen, which every readiness change bumps so
+// that a change between checking and sleeping is not missed. A timeout
+// is an hrtimer whose expiry calls pollwakeup().
+struct {
+	struct spinlock lock;
+	uint gen;
+} pollq;
+
+void fileinit(void) {
+	initlock(&ftable.lock, "ftable");
+	initlock(&pollq.lock, "pollq");
+}
 
 // Allocate a file structure.
 struct file *filealloc(void) {
@@ -44,6 +59,22 @@ struct file *filedup(struct file *f) {
 	return f;
 }
 
+// Return the file open as descriptor fd of the current process, or 0.
+// A thread sharing the descriptors may close fd meanwhile, so the
+// caller gets a reference of its own and drops it with fileclose().
+struct file *fileget(int fd) {
+	struct files *fs = myproc()->files;
+	struct file *f;
+
+	if (fd < 0 || fd >= NOFILE)
+		return 0;
+	acquire(&fs->lock);
+	if ((f = fs->ofile[fd]) != 0)
+		filedup(f);
+	release(&fs->lock);
+	return f;
+}
+
 // Close file f.  (Decrement ref count, close when reaches 0.)
 void fileclose(struct file *f) {
 	struct file ff;
@@ -80,6 +111,13 @@ int filestat(struct file *f, struct stat *st) {
 	return -1;
 }
 
+// Read directory entries from file f; see dirread.
+int filegetdents(struct file *f, char *addr, int n, int flags) {
+	if (f->readable == 0 || f->type != FD_INODE)
+		return -1;
+	return dirread(f->ip, &f->off, addr, n, flags);
+}
+
 // Read from file f.
 int fileread(struct file *f, char *addr, int n) {
 	int r;
@@ -108,18 +146,20 @@ int filewrite(struct file *f, char *addr, int n) {
 	if (f->type == FD_PIPE)
 		return pipewrite(f->pipe, addr, n);
 	if (f->type == FD_INODE) {
-		// write a few blocks at a time to avoid exceeding
-		// the maximum log transaction size, including
-		// i-node, indirect block, allocation blocks,
-		// and 2 blocks of slop for non-aligned writes.
+		// write as many whole blocks per transaction as the log
+		// allows: MAXOPBLOCKS minus the i-node, up to three
+		// indirect blocks on the double-indirect path and two
+		// allocation bitmap blocks. the first chunk is shortened
+		// so that every later chunk starts block-aligned.
 		// this really belongs lower down, since writei()
 		// might be writing a device like the console.
-		int max = ((MAXOPBLOCKS - 1 - 1 - 2) / 2) * 512;
+		int max = (MAXOPBLOCKS - 1 - 3 - 2) * BSIZE;
 		int i = 0;
 		while (i < n) {
 			int n1 = n - i;
-			if (n1 > max)
-				n1 = max;
+			int lim = max - f->off % BSIZE;
+			if (n1 > lim)
+				n1 = lim;
 
 			begin_op();
 			ilock(f->ip);
@@ -138,3 +178,108 @@ int filewrite(struct file *f, char *addr, int n) {
 	}
 	panic("filewrite");
 }
+
+// Move up to n bytes from fin to fout inside the kernel, staging them
+// in one page instead of bouncing through user space. A pipe source
+// stops after a short read, as read() would, so output can be streamed.
+// Returns the number of bytes moved, or -1 if nothing could be.
+int filesplice(struct file *fin, struct file *fout, int n) {
+	char *buf;
+	int m, r = 0, tot = 0;
+
+	if (fin->readable == 0 || fout->writable == 0 || n < 0)
+		return -1;
+	if ((buf = kalloc()) == 0)
+		return -1;
+
+	while (tot < n) {
+		m = n - tot < PGSIZE ? n - tot : PGSIZE;
+		if ((r = fileread(fin, buf, m)) <= 0)
+			break;
+		if (filewrite(fout, buf, r) != r) {
+			r = -1;
+			break;
+		}
+		tot += r;
+		if (fin->type == FD_PIPE && r < m)
+			break;
+	}
+
+	kfree(buf);
+	return r < 0 && tot == 0 ? -1 : tot;
+}
+
+// Return which of events (plus POLLHUP) file f is ready for.
+int filepoll(struct file *f, int events) {
+	int r = POLLIN | POLLOUT;
+
+	if (f->type == FD_PIPE)
+		r = pipepoll(f->pipe, f->writable);
+	else if (f->type == FD_INODE && f->ip->type == T_DEV &&
+		 f->ip->major >= 0 && f->ip->major < NDEV &&
+		 devsw[f->ip->major].poll)
+		r = devsw[f->ip->major].poll(f->ip);
+	if (!f->readable)
+		r &= ~POLLIN;
+	if (!f->writable)
+		r &= ~POLLOUT;
+	return r & (events | POLLHUP);
+}
+
+// Called whenever a pipe, device or window queue may have become ready.
+void pollwakeup(void) {
+	acquire(&pollq.lock);
+	pollq.gen++;
+	wakeup(&pollq.gen);
+	release(&pollq.lock);
+}
+
+static int pollone(struct pollfd *pf) {
+	struct file *f;
+	int r;
+
+	if (pf->events & POLLWND)
+		return wmpoll(pf->fd) & (pf->events | POLLHUP | POLLNVAL);
+	if ((f = fileget(pf->fd)) == 0)
+		return POLLNVAL;
+	r = filepoll(f, pf->events);
+	fileclose(f);
+	return r;
+}
+
+// Fill in revents for each of the n entries in fds, sleeping until at
+// least one is ready or timeout ticks pass (never if timeout is 0,
+// forever if it is negative). Returns the number of ready entries.
+int pollwait(struct pollfd *fds, int n, int timeout) {
+	struct proc *p = myproc();
+	struct pollfd *pf;
+	uint64 end = hrtime() + hrcycles(TICKUS) * (timeout > 0 ? timeout : 0);
+	uint gen;
+	int ready;
+
+	for (;;) {
+		acquire(&pollq.lock);
+		gen = pollq.gen;
+		release(&pollq.lock);
+
+		ready = 0;
+		for (pf = fds; pf < &fds[n]; pf++)
+			if ((pf->revents = pollone(pf)) != 0)
+				ready++;
+		if (ready || timeout == 0)
+			return ready;
+		if (timeout > 0 && hrtime() >= end)
+			return 0;
+		if (p->killed)
+			return -1;
+
+		if (timeout > 0)
+			hrarm(p, end, 0);
+		acquire(&pollq.lock);
+		if (pollq.gen == gen)
+			sleep(&pollq.gen, &pollq.lock);
+		release(&pollq.lock);
+		if (timeout > 0)
+			hrcancel(p);
+	}
+}
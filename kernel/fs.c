@@ -1,11 +1,13 @@
 // Modernized File System Implementation for NorthOS
-// Features: Large file support (double indirect), bitwise allocation,
-// checksum validation, and improved concurrency safety.
+// Features: Large file support (double indirect or extents), bitwise
+// allocation, checksum validation, and improved concurrency safety.
 
 #include "fs.h"
 #include "buf.h"
 #include "defs.h"
+#include "fcntl.h"
 #include "file.h"
+#include "memlayout.h"
 #include "mmu.h"
 #include "param.h"
 #include "proc.h"
@@ -26,22 +28,63 @@ STATIC_ASSERT(sizeof(struct dinode) == 128, INODE_SIZE_CORRUPT);
 // Superblock instance
 static struct superblock sb;
 
-// Allocation hint with synchronization for multiprocessor safety
+// Allocation hint with synchronization for multiprocessor safety.
+// alloc_lock also protects every inode's reservation window
+// (rsv_next/rsv_end) and rsvlist; bitmap bits are protected by the
+// bitmap buffer. Windows never overlap, and the non-empty ones are
+// linked through rsv_link in order of their start block.
 static uint last_alloc_hint = 0;
-static struct spinlock alloc_hint_lock;
+static struct spinlock alloc_lock;
+static struct inode *rsvlist;
 
 // Inode cache - MUST be declared before iinit()
+// Entries are carved out of kalloc()ed pages on demand, up to one per
+// IMEMPER bytes of the memory kalloc() manages, and found through a
+// hash on (dev, inum). Entries stay valid after their last iput() and
+// sit on an LRU list, most recently used first, until iget() recycles
+// them.
+#define IPP (PGSIZE / sizeof(struct inode))
+
 struct {
 	struct spinlock lock;
-	struct inode inode[NINODE];
+	struct inode *hash[NIHASH];
+	struct inode lru; // list head; lru.next is most recently used
+	uint n;		  // entries carved so far
+	uint max;	  // most entries to carve; set by iinit()
+	struct inode **page; // one kalloc()ed page of pointers to entry pages
 } icache;
 
+// Path-name lookup cache: maps (directory inum, name) to the inum it
+// names, or to 0 if the directory has no such entry. dirlink() and
+// dirunlink() keep it exact; freeing an inode purges everything keyed
+// by or pointing at it. The table is DCWAYS-way set associative with
+// LRU replacement inside a set.
+
+#define DCWAYS 4
+
+struct dentry {
+	uint dev;
+	uint pinum; // directory inode number, 0 if the slot is unused
+	uint inum;  // 0 for a negative entry
+	uint used;  // dcache.clock at last use
+	char name[DIRSIZ];
+};
+
+struct {
+	struct spinlock lock;
+	uint clock;
+	struct dentry ent[NDCACHE];
+} dcache;
+
 // Internal function prototypes
 static void itrunc(struct inode *);
-static uint bmap(struct inode *, uint);
+static uint bmap(struct inode *, uint, uint *, int *);
 static struct inode *iget(uint, uint);
 static void bfree(int, uint);
 static uint balloc(uint);
+static uint dalloc(struct inode *);
+static void rsvdrop(struct inode *);
+static void dcpurge(uint, uint);
 
 // Fletcher-32 Checksum for data integrity validation
 uint fletcher32(const ushort *data, int len) {
@@ -67,11 +110,16 @@ uint fletcher32(const ushort *data, int len) {
 // Initialize filesystem - called during boot
 void iinit(int dev) {
 	initlock(&icache.lock, "icache");
-	initlock(&alloc_hint_lock, "balloc_hint");
-
-	for (int i = 0; i < NINODE; i++) {
-		initsleeplock(&icache.inode[i].lock, "inode");
-	}
+	initlock(&alloc_lock, "balloc");
+	initlock(&dcache.lock, "dcache");
+	icache.lru.prev = &icache.lru;
+	icache.lru.next = &icache.lru;
+	icache.max = kmempages() / (IMEMPER / PGSIZE);
+	if (icache.max < NINODE)
+		icache.max = NINODE;
+	icache.max = MIN(icache.max, PGSIZE / sizeof(struct inode *) * IPP);
+	if ((icache.page = (struct inode **)kalloc()) == 0)
+		panic("iinit: icache");
 
 	readsb(dev, &sb);
 
@@ -101,7 +149,8 @@ void readsb(int dev, struct superblock *sb_ptr) {
 	memmove(&sb, sb_ptr, sizeof(sb));
 }
 
-// Zero a disk block safely
+// Zero a disk block safely. The old contents are irrelevant, so the
+// buffer is claimed without reading the block from disk.
 static void bzero(int dev, int bno) {
 	struct buf *bp;
 
@@ -109,79 +158,117 @@ static void bzero(int dev, int bno) {
 		panic("bzero: invalid block number");
 	}
 
-	bp = bread(dev, bno);
+	bp = bnew(dev, bno);
 	memset(bp->data, 0, BSIZE);
 	log_write(bp);
 	brelse(bp);
 }
 
-// Allocate a disk block using optimized bitwise scan
-static uint balloc(uint dev) {
-	struct buf *bp;
-	int bi, m;
-	uint bno = 0;
+// If block b lies inside the reservation window of an inode other than
+// ip, return the end of that window, else 0. Caller holds alloc_lock.
+static uint rsvowner(struct inode *ip, uint b) {
+	struct inode *x;
 
-	acquire(&alloc_hint_lock);
-	uint start = last_alloc_hint;
-	release(&alloc_hint_lock);
+	for (x = rsvlist; x && x->rsv_next <= b; x = x->rsv_link)
+		if (x != ip && b < x->rsv_end)
+			return x->rsv_end;
+	return 0;
+}
 
-	// Two passes: from hint to end, then from start to hint
-	for (int pass = 0; pass < 2; pass++) {
-		uint start_bmap, end_bmap;
+// Take ip's window off rsvlist. Caller holds alloc_lock.
+static void rsvunlink(struct inode *ip) {
+	struct inode **pp;
 
-		if (pass == 0) {
-			start_bmap = sb.bmapstart + (start / BPB);
-			end_bmap = sb.bmapstart + (sb.nblocks / BPB) + 1;
-			if (end_bmap > sb.bmapstart + (sb.size / BPB) + 1)
-				end_bmap = sb.bmapstart + (sb.size / BPB) + 1;
-		} else {
-			start_bmap = sb.bmapstart;
-			end_bmap = sb.bmapstart + (start / BPB);
+	for (pp = &rsvlist; *pp; pp = &(*pp)->rsv_link) {
+		if (*pp == ip) {
+			*pp = ip->rsv_link;
+			break;
 		}
+	}
+	ip->rsv_link = 0;
+}
 
-		for (uint bmap_block = start_bmap; bmap_block < end_bmap;
-		     bmap_block++) {
-			bp = bread(dev, bmap_block);
+// Put ip's new window on rsvlist. Caller holds alloc_lock.
+static void rsvinsert(struct inode *ip) {
+	struct inode **pp;
 
-			// Scan 32 bits at a time for efficiency (O(N/32))
-			for (int i = 0; i < BSIZE; i += 4) {
-				uint *word = (uint *)&bp->data[i];
+	for (pp = &rsvlist; *pp && (*pp)->rsv_next < ip->rsv_next;
+	     pp = &(*pp)->rsv_link)
+		;
+	ip->rsv_link = *pp;
+	*pp = ip;
+}
 
-				if (*word !=
-				    0xFFFFFFFF) { // Found free bit in this word
-					for (int bit = 0; bit < 32; bit++) {
-						bi = (i * 8) + bit;
-						if (bi >= BPB)
-							break;
+// Forget ip's reservation window; its blocks were never marked in use.
+static void rsvdrop(struct inode *ip) {
+	acquire(&alloc_lock);
+	rsvunlink(ip);
+	ip->rsv_next = ip->rsv_end = 0;
+	release(&alloc_lock);
+}
+
+// Find a free block at or after goal (wrapping around), skipping blocks
+// reserved by other inodes, mark it allocated and return it. The block
+// is not zeroed. If ip is non-zero, the free blocks that follow (up to
+// NRSVBLOCK) become ip's reservation window for its next allocations.
+static uint bscan(uint dev, uint goal, struct inode *ip) {
+	struct buf *bp;
+	uint b, bi, base, stop, lo, hi, end, n;
 
-						m = 1 << (bi % 8);
-						if ((bp->data[bi / 8] & m) ==
-						    0) {
-							// Allocate block
-							bp->data[bi / 8] |= m;
-							log_write(bp);
-							brelse(bp);
-
-							bno = ((bmap_block -
-								sb.bmapstart) *
-							       BPB) +
-							      bi;
-							if (bno >=
-							    (uint)sb.nblocks) {
-								continue; // Safety
-									  // check
-							}
-
-							bzero(dev, bno);
-
-							acquire(&alloc_hint_lock);
-							last_alloc_hint = bno;
-							release(&alloc_hint_lock);
-
-							return bno;
-						}
+	if (goal >= sb.nblocks)
+		goal = 0;
+
+	// Two passes: from goal to end, then from start to goal
+	for (int pass = 0; pass < 2; pass++) {
+		lo = pass == 0 ? goal : 0;
+		hi = pass == 0 ? sb.nblocks : goal;
+
+		for (b = lo; b < hi;) {
+			bp = bread(dev, BMAPBLOCK(b, sb));
+			base = b - b % BPB;
+			stop = MIN(hi, base + BPB);
+
+			for (; b < stop; b++) {
+				bi = b - base;
+
+				// Skip fully allocated words (O(N/32))
+				if (bi % 32 == 0 && b + 32 <= stop &&
+				    ((uint *)bp->data)[bi / 32] == 0xFFFFFFFF) {
+					b += 31;
+					continue;
+				}
+				if (bp->data[bi / 8] & (1 << (bi % 8)))
+					continue;
+
+				acquire(&alloc_lock);
+				if ((end = rsvowner(ip, b)) != 0) {
+					release(&alloc_lock);
+					b = end - 1;
+					continue;
+				}
+
+				bp->data[bi / 8] |= 1 << (bi % 8);
+				if (ip) {
+					for (n = 1; n < NRSVBLOCK && b + n < stop;
+					     n++) {
+						bi = b + n - base;
+						if ((bp->data[bi / 8] &
+						     (1 << (bi % 8))) ||
+						    rsvowner(ip, b + n))
+							break;
 					}
+					rsvunlink(ip);
+					ip->rsv_next = b + 1;
+					ip->rsv_end = b + n;
+					if (n > 1)
+						rsvinsert(ip);
 				}
+				last_alloc_hint = b;
+				release(&alloc_lock);
+
+				log_write(bp);
+				brelse(bp);
+				return b;
 			}
 			brelse(bp);
 		}
@@ -190,6 +277,57 @@ static uint balloc(uint dev) {
 	panic("balloc: out of blocks");
 }
 
+// Allocate a zeroed disk block for metadata (indirect and extent blocks)
+static uint balloc(uint dev) {
+	uint b, goal;
+
+	acquire(&alloc_lock);
+	goal = last_alloc_hint;
+	release(&alloc_lock);
+
+	b = bscan(dev, goal, 0);
+	bzero(dev, b);
+	return b;
+}
+
+// Allocate a data block for ip. Files grow by appending, so the block
+// comes from ip's reservation window when it has one, which keeps the
+// file contiguous on disk even while other files grow concurrently.
+// The block is not zeroed: writei() fills it without reading it back.
+static uint dalloc(struct inode *ip) {
+	struct buf *bp;
+	uint b, bi, goal;
+	int have;
+
+	acquire(&alloc_lock);
+	b = ip->rsv_next;
+	have = b < ip->rsv_end;
+	goal = ip->rsv_end ? ip->rsv_end : last_alloc_hint;
+	release(&alloc_lock);
+
+	if (have) {
+		bp = bread(ip->dev, BMAPBLOCK(b, sb));
+		bi = b % BPB;
+		acquire(&alloc_lock);
+		if ((bp->data[bi / 8] & (1 << (bi % 8))) == 0) {
+			bp->data[bi / 8] |= 1 << (bi % 8);
+			if (++ip->rsv_next == ip->rsv_end)
+				rsvunlink(ip); // used up; rsv_end stays the goal
+			release(&alloc_lock);
+			log_write(bp);
+			brelse(bp);
+			return b;
+		}
+		// Stale window; start a new one past it.
+		rsvunlink(ip);
+		ip->rsv_next = ip->rsv_end = 0;
+		release(&alloc_lock);
+		brelse(bp);
+	}
+
+	return bscan(ip->dev, goal, ip);
+}
+
 // Release a disk block back to free pool
 static void bfree(int dev, uint b) {
 	struct buf *bp;
@@ -224,6 +362,10 @@ struct inode *ialloc(uint dev, short type) {
 		if (dip->data.type == 0) { // Free inode found
 			memset(dip, 0, sizeof(*dip));
 			dip->data.type = type;
+			if (type == T_FILE && (sb.features & FS_EXTENTS))
+				dip->data.flags = DI_EXTENTS;
+			if (type == T_DIR && (sb.features & FS_DIRHASH))
+				dip->data.flags = DI_DIRHASH;
 			log_write(bp);
 			brelse(bp);
 			return iget(dev, inum);
@@ -250,39 +392,95 @@ void iupdate(struct inode *ip) {
 	dip->data.minor = ip->minor;
 	dip->data.nlink = ip->nlink;
 	dip->data.size = ip->size;
+	dip->data.flags = ip->flags;
+	dip->data.hlevel = ip->hlevel;
+	dip->data.hsplit = ip->hsplit;
+	dip->data.hovfl = ip->hovfl;
+	dip->data.gen = ip->gen;
 	memmove(dip->data.addrs, ip->addrs, sizeof(ip->addrs));
 
 	log_write(bp);
 	brelse(bp);
 }
 
-// Find or allocate inode cache entry
+// Return the head of the hash chain for inode inum on device dev.
+static struct inode **ihash(uint dev, uint inum) {
+	return &icache.hash[(inum ^ dev << 16) % NIHASH];
+}
+
+static void lrudel(struct inode *ip) {
+	ip->next->prev = ip->prev;
+	ip->prev->next = ip->next;
+}
+
+// Put an unreferenced inode on the LRU list. Invalid inodes go to the
+// cold end so they are recycled first.
+static void lruadd(struct inode *ip) {
+	struct inode *at = ip->valid ? &icache.lru : icache.lru.prev;
+
+	ip->next = at->next;
+	ip->prev = at;
+	at->next->prev = ip;
+	at->next = ip;
+}
+
+// Carve a new cache entry, or return 0 if the cache is at its limit or
+// out of memory. Caller holds icache.lock.
+static struct inode *inew(void) {
+	struct inode *ip;
+	char *page;
+
+	if (icache.n >= icache.max)
+		return 0;
+	if (icache.n % IPP == 0) {
+		if ((page = kalloc()) == 0)
+			return 0;
+		memset(page, 0, PGSIZE);
+		icache.page[icache.n / IPP] = (struct inode *)page;
+	}
+	ip = &icache.page[icache.n / IPP][icache.n % IPP];
+	initsleeplock(&ip->lock, "inode");
+	icache.n++;
+	return ip;
+}
+
+// Find or allocate inode cache entry: return the in-memory copy of
+// inode inum on device dev, recycling the least recently used entry if
+// the cache cannot grow. Does not lock the inode and does not read it
+// from disk.
 static struct inode *iget(uint dev, uint inum) {
-	struct inode *ip, *empty = 0;
+	struct inode *ip, **pp;
 
 	acquire(&icache.lock);
 
 	// Is the inode already cached?
-	for (ip = &icache.inode[0]; ip < &icache.inode[NINODE]; ip++) {
-		if (ip->ref > 0 && ip->dev == dev && ip->inum == inum) {
-			ip->ref++;
+	for (ip = *ihash(dev, inum); ip; ip = ip->hnext) {
+		if (ip->dev == dev && ip->inum == inum) {
+			if (ip->ref++ == 0)
+				lrudel(ip);
 			release(&icache.lock);
 			return ip;
 		}
-		if (empty == 0 && ip->ref == 0)
-			empty = ip;
 	}
 
-	// Recycle an inode cache entry
-	if (empty == 0) {
-		panic("iget: no free inodes in cache");
+	if ((ip = inew()) == 0) {
+		ip = icache.lru.prev;
+		if (ip == &icache.lru) {
+			panic("iget: no free inodes in cache");
+		}
+		lrudel(ip);
+		for (pp = ihash(ip->dev, ip->inum); *pp != ip; pp = &(*pp)->hnext)
+			;
+		*pp = ip->hnext;
 	}
 
-	ip = empty;
 	ip->dev = dev;
 	ip->inum = inum;
 	ip->ref = 1;
 	ip->valid = 0;
+	pp = ihash(dev, inum);
+	ip->hnext = *pp;
+	*pp = ip;
 
 	release(&icache.lock);
 	return ip;
@@ -320,6 +518,11 @@ void ilock(struct inode *ip) {
 		ip->minor = dip->data.minor;
 		ip->nlink = dip->data.nlink;
 		ip->size = dip->data.size;
+		ip->flags = dip->data.flags;
+		ip->hlevel = dip->data.hlevel;
+		ip->hsplit = dip->data.hsplit;
+		ip->hovfl = dip->data.hovfl;
+		ip->gen = dip->data.gen;
 		memmove(ip->addrs, dip->data.addrs, sizeof(ip->addrs));
 
 		brelse(bp);
@@ -355,13 +558,17 @@ void iput(struct inode *ip) {
 			ip->type = 0;
 			iupdate(ip);
 			ip->valid = 0;
+			dcpurge(ip->dev, ip->inum);
 		}
 	}
 
 	releasesleep(&ip->lock);
 
 	acquire(&icache.lock);
-	ip->ref--;
+	if (ip->ref == 1)
+		rsvdrop(ip); // unused blocks go back to the common pool
+	if (--ip->ref == 0)
+		lruadd(ip);
 	release(&icache.lock);
 }
 
@@ -371,15 +578,134 @@ void iunlockput(struct inode *ip) {
 	iput(ip);
 }
 
-// Map file block to disk block (supports direct, single, double indirect)
-static uint bmap(struct inode *ip, uint bn) {
+// Start a new extent block at index slot k, mapping file block bn to
+// disk block addr. ibp holds the index block.
+static void xextnew(struct inode *ip, struct buf *ibp, int k, uint bn,
+		    uint addr) {
+	struct xindex *ix = (struct xindex *)ibp->data;
+	struct extent *e;
+	struct buf *bp;
+
+	ix[k].fbn = bn;
+	ix[k].blk = balloc(ip->dev);
+	log_write(ibp);
+	bp = bread(ip->dev, ix[k].blk);
+	e = (struct extent *)bp->data;
+	e[0].start = addr;
+	e[0].len = 1;
+	log_write(bp);
+	brelse(bp);
+}
+
+// Map file block to disk block for an extent-mapped inode. Sets *run to
+// the number of physically contiguous blocks starting at bn, so callers
+// can stream a whole run without mapping every block. If bn is the first
+// unmapped block, append it, growing the last extent when the new block
+// is adjacent, and set *fresh. A lookup past the inline runs reads the
+// index block and the one extent block covering bn. Returns 0 if the
+// map is full.
+static uint emap(struct inode *ip, uint bn, uint *run, int *fresh) {
+	struct extent *e = (struct extent *)ip->addrs;
+	struct xindex *ix;
+	struct buf *ibp, *bp;
+	uint lbn = 0, addr;
+	int i, k;
+
+	for (i = 0; i < NIEXTENT && e[i].len; i++) {
+		if (bn < lbn + e[i].len) {
+			*run = e[i].len - (bn - lbn);
+			return e[i].start + (bn - lbn);
+		}
+		lbn += e[i].len;
+	}
+
+	if (i < NIEXTENT || ip->addrs[XEXTBLK] == 0) {
+		if (bn != lbn)
+			panic("emap: hole in extent map");
+		addr = dalloc(ip);
+		*run = 1;
+		*fresh = 1;
+		if (i > 0 && e[i - 1].start + e[i - 1].len == addr) {
+			e[i - 1].len++;
+		} else if (i < NIEXTENT) {
+			e[i].start = addr;
+			e[i].len = 1;
+		} else {
+			ip->addrs[XEXTBLK] = balloc(ip->dev);
+			ibp = bread(ip->dev, ip->addrs[XEXTBLK]);
+			xextnew(ip, ibp, 0, bn, addr);
+			brelse(ibp);
+		}
+		return addr;
+	}
+
+	// Find the last extent block starting at or before bn.
+	ibp = bread(ip->dev, ip->addrs[XEXTBLK]);
+	ix = (struct xindex *)ibp->data;
+	for (k = 0; k + 1 < NXINDEX && ix[k + 1].blk && ix[k + 1].fbn <= bn;
+	     k++)
+		;
+	bp = bread(ip->dev, ix[k].blk);
+	e = (struct extent *)bp->data;
+	lbn = ix[k].fbn;
+	for (i = 0; i < NXEXTENT && e[i].len; i++) {
+		if (bn < lbn + e[i].len) {
+			*run = e[i].len - (bn - lbn);
+			addr = e[i].start + (bn - lbn);
+			brelse(bp);
+			brelse(ibp);
+			return addr;
+		}
+		lbn += e[i].len;
+	}
+
+	if (bn != lbn || (k + 1 < NXINDEX && ix[k + 1].blk))
+		panic("emap: hole in extent map");
+	if (i == NXEXTENT && k + 1 == NXINDEX) {
+		brelse(bp);
+		brelse(ibp);
+		return 0;
+	}
+	addr = dalloc(ip);
+	*run = 1;
+	*fresh = 1;
+	if (e[i - 1].start + e[i - 1].len == addr) {
+		e[i - 1].len++;
+		log_write(bp);
+	} else if (i < NXEXTENT) {
+		e[i].start = addr;
+		e[i].len = 1;
+		log_write(bp);
+	} else {
+		xextnew(ip, ibp, k + 1, bn, addr);
+	}
+	brelse(bp);
+	brelse(ibp);
+	return addr;
+}
+
+// Map file block to disk block (supports direct, single, double indirect,
+// and extents). *run receives the number of contiguous disk blocks that
+// start at the returned address; the block-pointer format reports 1.
+// If fresh is not 0, *fresh is set to whether the data block was just
+// allocated, and so holds garbage rather than file contents.
+static uint bmap(struct inode *ip, uint bn, uint *run, int *fresh) {
 	uint addr, *a;
 	struct buf *bp;
+	int dummy;
+
+	if (fresh == 0)
+		fresh = &dummy;
+	*fresh = 0;
+	if (ip->flags & DI_EXTENTS)
+		return emap(ip, bn, run, fresh);
+	*run = 1;
 
 	// Direct blocks
 	if (bn < NDIRECT) {
 		if ((addr = ip->addrs[bn]) == 0) {
-			ip->addrs[bn] = addr = balloc(ip->dev);
+			ip->addrs[bn] = addr = dalloc(ip);
+			*fresh = 1;
 		}
 		return addr;
 	}
@@ -393,7 +719,8 @@ static uint bmap(struct inode *ip, uint bn) {
 		bp = bread(ip->dev, addr);
 		a = (uint *)bp->data;
 		if ((addr = a[bn]) == 0) {
-			a[bn] = addr = balloc(ip->dev);
+			a[bn] = addr = dalloc(ip);
+			*fresh = 1;
 			log_write(bp);
 		}
 		brelse(bp);
@@ -424,7 +751,8 @@ static uint bmap(struct inode *ip, uint bn) {
 		uint idx2 = bn % NINDIRECT;
 
 		if ((addr = a[idx2]) == 0) {
-			a[idx2] = addr = balloc(ip->dev);
+			a[idx2] = addr = dalloc(ip);
+			*fresh = 1;
 			log_write(bp);
 		}
 		brelse(bp);
@@ -434,11 +762,51 @@ static uint bmap(struct inode *ip, uint bn) {
 	panic("bmap: block number out of range");
 }
 
+// Free every block of an extent-mapped inode, including the
+// extent index and extent blocks.
+static void etrunc(struct inode *ip) {
+	struct extent *e = (struct extent *)ip->addrs;
+	struct xindex *ix;
+	struct buf *ibp, *bp;
+
+	for (int i = 0; i < NIEXTENT && e[i].len; i++) {
+		for (uint b = 0; b < e[i].len; b++)
+			bfree(ip->dev, e[i].start + b);
+	}
+
+	if (ip->addrs[XEXTBLK]) {
+		ibp = bread(ip->dev, ip->addrs[XEXTBLK]);
+		ix = (struct xindex *)ibp->data;
+		for (int k = 0; k < NXINDEX && ix[k].blk; k++) {
+			bp = bread(ip->dev, ix[k].blk);
+			e = (struct extent *)bp->data;
+			for (int i = 0; i < NXEXTENT && e[i].len; i++) {
+				for (uint b = 0; b < e[i].len; b++)
+					bfree(ip->dev, e[i].start + b);
+			}
+			brelse(bp);
+			bfree(ip->dev, ix[k].blk);
+		}
+		brelse(ibp);
+		bfree(ip->dev, ip->addrs[XEXTBLK]);
+	}
+
+	memset(ip->addrs, 0, sizeof(ip->addrs));
+	ip->size = 0;
+	rsvdrop(ip);
+	iupdate(ip);
+}
+
 // Truncate inode (free all data blocks)
 static void itrunc(struct inode *ip) {
 	struct buf *bp, *bp2;
 	uint *a, *a2;
 
+	if (ip->flags & DI_EXTENTS) {
+		etrunc(ip);
+		return;
+	}
+
 	// Free direct blocks
 	for (int i = 0; i < NDIRECT; i++) {
 		if (ip->addrs[i]) {
@@ -484,6 +852,7 @@ static void itrunc(struct inode *ip) {
 	}
 
 	ip->size = 0;
+	rsvdrop(ip);
 	iupdate(ip);
 }
 
@@ -498,11 +867,12 @@ void stati(struct inode *ip, struct stat *st) {
 	st->type = ip->type;
 	st->nlink = ip->nlink;
 	st->size = ip->size;
+	st->gen = ip->gen;
 }
 
 // Read data from inode with overflow protection
 int readi(struct inode *ip, char *dst, uint off, uint n) {
-	uint tot, m;
+	uint tot, m, addr = 0, run = 0;
 	struct buf *bp;
 
 	if (ip->type == T_DEV) {
@@ -521,10 +891,17 @@ int readi(struct inode *ip, char *dst, uint off, uint n) {
 	}
 
 	for (tot = 0; tot < n; tot += m, off += m, dst += m) {
-		bp = bread(ip->dev, bmap(ip, off / BSIZE));
+		// Only map again once the current contiguous run is used up.
+		if (run == 0)
+			addr = bmap(ip, off / BSIZE, &run, 0);
+		bp = bread(ip->dev, addr);
 		m = MIN(n - tot, BSIZE - off % BSIZE);
 		memmove(dst, bp->data + off % BSIZE, m);
 		brelse(bp);
+		if ((off + m) % BSIZE == 0) {
+			addr++;
+			run--;
+		}
 	}
 
 	return n;
@@ -532,8 +909,9 @@ int readi(struct inode *ip, char *dst, uint off, uint n) {
 
 // Write data to inode with bounds checking
 int writei(struct inode *ip, char *src, uint off, uint n) {
-	uint tot, m;
+	uint tot, m, addr = 0, run = 0;
 	struct buf *bp;
+	int fresh = 0;
 
 	if (ip->type == T_DEV) {
 		if (ip->major < 0 || ip->major >= NDEV ||
@@ -552,55 +930,320 @@ int writei(struct inode *ip, char *src, uint off, uint n) {
 	}
 
 	for (tot = 0; tot < n; tot += m, off += m, src += m) {
-		bp = bread(ip->dev, bmap(ip, off / BSIZE));
+		if (run == 0 &&
+		    (addr = bmap(ip, off / BSIZE, &run, &fresh)) == 0)
+			break; // extent table full
 		m = MIN(n - tot, BSIZE - off % BSIZE);
+		if (fresh) {
+			// Block was just allocated: skip the disk read and
+			// zero only what this write leaves uncovered, all in
+			// a single log write.
+			bp = bnew(ip->dev, addr);
+			memset(bp->data, 0, off % BSIZE);
+			memset(bp->data + off % BSIZE + m, 0,
+			       BSIZE - off % BSIZE - m);
+			fresh = 0;
+		} else {
+			bp = bread(ip->dev, addr);
+		}
 		memmove(bp->data + off % BSIZE, src, m);
 		log_write(bp);
 		brelse(bp);
+		if ((off + m) % BSIZE == 0) {
+			addr++;
+			run--;
+		}
 	}
 
 	// Update size if file grew
-	if (n > 0 && off > ip->size) {
+	if (tot > 0 && off > ip->size) {
 		ip->size = off;
 		iupdate(ip);
 	}
 
-	return n;
+	return tot == n ? n : -1;
 }
 
 // Directory name comparison
 int namecmp(const char *s, const char *t) { return strncmp(s, t, DIRSIZ); }
 
+// Directories are arrays of dirents, so user programs can read them
+// directly. A DI_DIRHASH directory additionally places every entry in
+// a bucket chosen by linear hashing on its name: bucket i is directory
+// block i, and a lookup reads a single block. The table grows one
+// bucket at a time: when an insert finds its bucket full, bucket
+// hsplit is split into itself and a new block appended to the
+// directory. "." and ".." always stay in slots 0 and 1 of block 0.
+// An entry that still does not fit goes into any free slot and is
+// counted in hovfl; while hovfl is non-zero, a lookup that misses its
+// bucket falls back to a full scan. Other directories are scanned
+// linearly.
+
+#define DPB (BSIZE / sizeof(struct dirent)) // dirents per block
+
+static char zeroblk[BSIZE];
+
+static uint dirhash(char *name) {
+	uint h = 2166136261u; // FNV-1a
+
+	for (int i = 0; i < DIRSIZ && name[i]; i++) {
+		h ^= (uchar)name[i];
+		h *= 16777619u;
+	}
+	return h;
+}
+
+// Bucket (= directory block) that entry hash h belongs in.
+static uint dirbucket(struct inode *dp, uint h) {
+	uint b = h & ((1u << dp->hlevel) - 1);
+
+	if (b < dp->hsplit)
+		b = h & ((2u << dp->hlevel) - 1);
+	return b;
+}
+
+static int isdots(char *name) {
+	return namecmp(name, ".") == 0 || namecmp(name, "..") == 0;
+}
+
+// Find the entry for (dev, pinum, name); if absent and alloc is set,
+// recycle the least recently used slot of its set. Caller holds
+// dcache.lock.
+static struct dentry *dcfind(uint dev, uint pinum, char *name, int alloc) {
+	uint set = (dirhash(name) ^ pinum * 2654435761u) % (NDCACHE / DCWAYS);
+	struct dentry *e, *victim = &dcache.ent[set * DCWAYS];
+
+	for (e = victim; e < &dcache.ent[(set + 1) * DCWAYS]; e++) {
+		if (e->pinum == pinum && e->dev == dev &&
+		    namecmp(e->name, name) == 0) {
+			e->used = ++dcache.clock;
+			return e;
+		}
+		if (e->used < victim->used)
+			victim = e;
+	}
+	if (!alloc)
+		return 0;
+
+	victim->dev = dev;
+	victim->pinum = pinum;
+	strncpy(victim->name, name, DIRSIZ);
+	victim->used = ++dcache.clock;
+	return victim;
+}
+
+// Returns 1 and sets *pinum (0: known not to exist) on a cache hit.
+static int dclookup(struct inode *dp, char *name, uint *pinum) {
+	struct dentry *e;
+
+	acquire(&dcache.lock);
+	if ((e = dcfind(dp->dev, dp->inum, name, 0)) != 0)
+		*pinum = e->inum;
+	release(&dcache.lock);
+	return e != 0;
+}
+
+static void dcenter(struct inode *dp, char *name, uint inum) {
+	acquire(&dcache.lock);
+	dcfind(dp->dev, dp->inum, name, 1)->inum = inum;
+	release(&dcache.lock);
+}
+
+// Drop every entry in directory inum or naming inum.
+static void dcpurge(uint dev, uint inum) {
+	struct dentry *e;
+
+	acquire(&dcache.lock);
+	for (e = dcache.ent; e < &dcache.ent[NDCACHE]; e++) {
+		if (e->dev == dev && (e->pinum == inum || e->inum == inum)) {
+			e->pinum = 0;
+			e->used = 0;
+		}
+	}
+	release(&dcache.lock);
+}
+
+// Scan directory blocks [b0, b1) for an entry called name, or for a
+// free slot if name is 0. On success set *poff (and *pinum) and
+// return 1.
+static int dirscan(struct inode *dp, char *name, uint b0, uint b1, uint *poff,
+		   uint *pinum) {
+	struct buf *bp;
+	struct dirent *de;
+	uint b, i, n, run;
+
+	for (b = b0; b < b1 && b * BSIZE < dp->size; b++) {
+		bp = bread(dp->dev, bmap(dp, b, &run, 0));
+		de = (struct dirent *)bp->data;
+		n = MIN(BSIZE, dp->size - b * BSIZE) / sizeof(*de);
+		for (i = 0; i < n; i++) {
+			if (name ? de[i].inum != 0 &&
+					   namecmp(name, de[i].name) == 0
+				 : de[i].inum == 0) {
+				*poff = b * BSIZE + i * sizeof(*de);
+				if (pinum)
+					*pinum = de[i].inum;
+				brelse(bp);
+				return 1;
+			}
+		}
+		brelse(bp);
+	}
+	return 0;
+}
+
 // Look for name in directory
 struct inode *dirlookup(struct inode *dp, char *name, uint *poff) {
-	uint off;
-	struct dirent de;
+	uint off, inum, b, nb;
+	int found;
 
 	if (dp->type != T_DIR) {
 		panic("dirlookup: not a directory");
 	}
 
-	for (off = 0; off < dp->size; off += sizeof(de)) {
-		if (readi(dp, (char *)&de, off, sizeof(de)) != sizeof(de)) {
-			panic("dirlookup: read error");
-		}
-		if (de.inum == 0) {
-			continue;
+	if (poff == 0 && dclookup(dp, name, &inum)) {
+		return inum ? iget(dp->dev, inum) : 0;
+	}
+
+	nb = (dp->size + BSIZE - 1) / BSIZE;
+	if (!(dp->flags & DI_DIRHASH)) {
+		found = dirscan(dp, name, 0, nb, &off, &inum);
+	} else if (isdots(name)) {
+		found = dirscan(dp, name, 0, 1, &off, &inum);
+	} else {
+		b = dirbucket(dp, dirhash(name));
+		found = dirscan(dp, name, b, b + 1, &off, &inum);
+		if (!found && dp->hovfl)
+			found = dirscan(dp, name, 0, b, &off, &inum) ||
+				dirscan(dp, name, b + 1, nb, &off, &inum);
+	}
+
+	dcenter(dp, name, found ? inum : 0);
+	if (!found) {
+		return 0;
+	}
+	if (poff) {
+		*poff = off;
+	}
+	return iget(dp->dev, inum);
+}
+
+// Copy the used entries of directory dp from *off on to dst as struct
+// dirent records, or struct dirstat ones with DENT_STAT, while they fit
+// in n bytes. Slots are read a page at a time and *off moves past them.
+//
+// A DENT_STAT type and size come from the on-disk inode, read under its
+// block's buffer lock, which ialloc() and iupdate() also hold; that
+// takes no inode reference, so no transaction is needed and an entry
+// whose inode was freed since its slot was read (type 0) is skipped.
+//
+// dp is unlocked between pages, so a concurrent dirsplit() can move
+// entries from a bucket already read into the new one at the end:
+// such an entry comes back twice. Entries only move forward, so none
+// is missed.
+int dirread(struct inode *dp, uint *off, char *dst, int n, int flags) {
+	struct dirent *de, *end;
+	struct dirstat ds;
+	struct dinode *dip;
+	struct buf *bp;
+	int sz = (flags & DENT_STAT) ? sizeof(ds) : sizeof(*de);
+	int tot = 0, m;
+	char *buf;
+
+	if ((buf = kalloc()) == 0)
+		return -1;
+	memset(&ds, 0, sizeof(ds));
+	while ((m = (n - tot) / sz) > 0) {
+		m = MIN(m, PGSIZE / sizeof(*de)) * sizeof(*de);
+		ilock(dp);
+		if (dp->type != T_DIR) {
+			iunlock(dp);
+			tot = -1;
+			break;
 		}
-		if (namecmp(name, de.name) == 0) {
-			if (poff) {
-				*poff = off;
+		m = readi(dp, buf, *off, m);
+		iunlock(dp);
+		if (m <= 0)
+			break;
+		*off += m;
+
+		end = (struct dirent *)(buf + m);
+		bp = 0;
+		for (de = (struct dirent *)buf; de < end; de++) {
+			if (de->inum == 0)
+				continue;
+			if (!(flags & DENT_STAT)) {
+				memmove(dst + tot, de, sz);
+				tot += sz;
+				continue;
+			}
+			if (de->inum >= sb.ninodes)
+				continue;
+			if (bp == 0 || bp->blockno != IBLOCK(de->inum, sb)) {
+				if (bp)
+					brelse(bp);
+				bp = bread(dp->dev, IBLOCK(de->inum, sb));
 			}
-			return iget(dp->dev, de.inum);
+			dip = (struct dinode *)bp->data + de->inum % IPB;
+			if (dip->data.type == 0)
+				continue;
+			ds.inum = de->inum;
+			memmove(ds.name, de->name, DIRSIZ);
+			ds.type = dip->data.type;
+			ds.size = dip->data.size;
+			memmove(dst + tot, &ds, sz);
+			tot += sz;
 		}
+		if (bp)
+			brelse(bp);
 	}
+	kfree(buf);
+	return tot;
+}
 
-	return 0;
+// Split bucket hsplit of a hashed directory: append a new bucket block
+// and move over the entries that now hash to it.
+static void dirsplit(struct inode *dp) {
+	struct buf *bp, *bq;
+	struct dirent *dep, *deq;
+	uint p = dp->hsplit, q = (1u << dp->hlevel) + p;
+	uint mask = (2u << dp->hlevel) - 1;
+	uint i, j = 0, run;
+
+	if (dp->size != q * BSIZE) {
+		panic("dirsplit: bucket count");
+	}
+	if (writei(dp, zeroblk, dp->size, BSIZE) != BSIZE) {
+		panic("dirsplit: write error");
+	}
+
+	bp = bread(dp->dev, bmap(dp, p, &run, 0));
+	bq = bread(dp->dev, bmap(dp, q, &run, 0));
+	dep = (struct dirent *)bp->data;
+	deq = (struct dirent *)bq->data;
+	for (i = (p == 0) ? 2 : 0; i < DPB; i++) {
+		if (dep[i].inum == 0 || (dirhash(dep[i].name) & mask) != q)
+			continue;
+		deq[j++] = dep[i];
+		memset(&dep[i], 0, sizeof(dep[i]));
+	}
+	if (j > 0) {
+		log_write(bp);
+		log_write(bq);
+	}
+	brelse(bq);
+	brelse(bp);
+
+	if (++dp->hsplit == (1u << dp->hlevel)) {
+		dp->hlevel++;
+		dp->hsplit = 0;
+	}
+	iupdate(dp);
 }
 
 // Add directory entry
 int dirlink(struct inode *dp, char *name, uint inum) {
-	int off;
+	uint off, b;
 	struct dirent de;
 	struct inode *ip;
 
@@ -610,13 +1253,29 @@ int dirlink(struct inode *dp, char *name, uint inum) {
 		return -1; // Already exists
 	}
 
-	// Look for empty slot
-	for (off = 0; off < dp->size; off += sizeof(de)) {
-		if (readi(dp, (char *)&de, off, sizeof(de)) != sizeof(de)) {
-			panic("dirlink: read error");
+	if (!(dp->flags & DI_DIRHASH)) {
+		// Look for empty slot, else append
+		if (!dirscan(dp, 0, 0, (dp->size + BSIZE - 1) / BSIZE, &off,
+			     0))
+			off = dp->size;
+	} else {
+		if (dp->size == 0 &&
+		    writei(dp, zeroblk, 0, BSIZE) != BSIZE) {
+			panic("dirlink: write error");
 		}
-		if (de.inum == 0) {
-			break;
+		b = isdots(name) ? 0 : dirbucket(dp, dirhash(name));
+		if (!dirscan(dp, 0, b, b + 1, &off, 0)) {
+			dirsplit(dp);
+			b = dirbucket(dp, dirhash(name));
+			if (!dirscan(dp, 0, b, b + 1, &off, 0)) {
+				// The split left room in one of its two
+				// buckets; park the entry outside its own.
+				if (!dirscan(dp, 0, 0, dp->size / BSIZE, &off,
+					     0))
+					panic("dirlink: no free slot");
+				dp->hovfl++;
+				iupdate(dp);
+			}
 		}
 	}
 
@@ -626,10 +1285,35 @@ int dirlink(struct inode *dp, char *name, uint inum) {
 	if (writei(dp, (char *)&de, off, sizeof(de)) != sizeof(de)) {
 		panic("dirlink: write error");
 	}
+	dcenter(dp, name, inum);
+	dp->gen++;
+	iupdate(dp);
 
 	return 0;
 }
 
+// Remove the directory entry at off, as returned by dirlookup().
+void dirunlink(struct inode *dp, uint off) {
+	struct dirent de;
+
+	if (readi(dp, (char *)&de, off, sizeof(de)) != sizeof(de)) {
+		panic("dirunlink: read error");
+	}
+	dcenter(dp, de.name, 0);
+	if ((dp->flags & DI_DIRHASH) && !isdots(de.name) &&
+	    off / BSIZE != dirbucket(dp, dirhash(de.name))) {
+		dp->hovfl--;
+		iupdate(dp);
+	}
+
+	memset(&de, 0, sizeof(de));
+	if (writei(dp, (char *)&de, off, sizeof(de)) != sizeof(de)) {
+		panic("dirunlink: write error");
+	}
+	dp->gen++;
+	iupdate(dp);
+}
+
 // Parse path element
 static char *skipelem(char *path, char *name) {
 	char *s;
@@ -670,7 +1354,9 @@ static struct inode *namex(char *path, int nameiparent, char *name) {
 	if (*path == '/') {
 		ip = iget(ROOTDEV, ROOTINO);
 	} else {
-		ip = idup(myproc()->cwd);
+		acquire(&myproc()->files->lock);
+		ip = idup(myproc()->files->cwd);
+		release(&myproc()->files->lock);
 	}
 
 	while ((path = skipelem(path, name)) != 0) {
@@ -0,0 +1,128 @@
+//
+// Futexes: sleep until the int at a user address changes.
+// A waiter is keyed by its page directory and the virtual address,
+// so threads of one process meet on the same word. Waiters hang off
+// one of NFUTEX hashed queues; each queue's lock is held from the
+// check of the user's value until the waiter is asleep, so a waker
+// that changes the value and then calls futexwake() can't miss it.
+//
+
+#include "defs.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "param.h"
+#include "proc.h"
+#include "spinlock.h"
+#include "types.h"
+#include "x86.h"
+
+#define NFUTEX 64
+
+struct waiter {
+	pde_t *pgdir;
+	uint va;
+	int woken;
+	struct waiter *next;
+};
+
+static struct futexq {
+	struct spinlock lock;
+	struct waiter *head;
+} futexq[NFUTEX];
+
+void futexinit(void) {
+	int i;
+
+	for (i = 0; i < NFUTEX; i++)
+		initlock(&futexq[i].lock, "futex");
+}
+
+static struct futexq *futexhash(pde_t *pgdir, uint va) {
+	return &futexq[((uint)pgdir / PGSIZE ^ va / 4) % NFUTEX];
+}
+
+// Read the user int at va through pgdir without faulting.
+static int futexread(pde_t *pgdir, uint va, int *ip) {
+	pte_t *pte;
+
+	pte = walkpgdir(pgdir, (char *)va, 0);
+	if (pte == 0 || (*pte & (PTE_P | PTE_U)) != (PTE_P | PTE_U))
+		return -1;
+	*ip = *(int *)(P2V(PTE_ADDR(*pte)) + (va & (PGSIZE - 1)));
+	return 0;
+}
+
+// Sleep until woken at va, if the int there still equals val.
+// Return 0 once woken, -1 if the value differed or p was killed.
+int futexwait(uint va, int val) {
+	struct proc *p = myproc();
+	pde_t *pgdir = p->pgdir;
+	struct futexq *q = futexhash(pgdir, va);
+	struct waiter w, **pp;
+	int cur;
+
+	acquire(&q->lock);
+	if (futexread(pgdir, va, &cur) < 0 || cur != val) {
+		release(&q->lock);
+		return -1;
+	}
+	w.pgdir = pgdir;
+	w.va = va;
+	w.woken = 0;
+	w.next = q->head;
+	q->head = &w;
+	while (!w.woken && !p->killed)
+		sleep(&w, &q->lock);
+	if (!w.woken) {
+		for (pp = &q->head; *pp != &w; pp = &(*pp)->next)
+			;
+		*pp = w.next;
+	}
+	release(&q->lock);
+	return w.woken ? 0 : -1;
+}
+
+// Wake up to n waiters at va; return how many were woken.
+int futexwake(uint va, int n) {
+	pde_t *pgdir = myproc()->pgdir;
+	struct futexq *q = futexhash(pgdir, va);
+	struct waiter *w, **pp;
+	int woken = 0;
+
+	acquire(&q->lock);
+	for (pp = &q->head; *pp && woken < n;) {
+		w = *pp;
+		if (w->pgdir != pgdir || w->va != va) {
+			pp = &w->next;
+			continue;
+		}
+		*pp = w->next;
+		w->woken = 1;
+		wakeup(w);
+		woken++;
+	}
+	release(&q->lock);
+	return woken;
+}
+
+int sys_futexwait(void) {
+	char *addr;
+	int val;
+
+	if (arginptr(0, &addr, sizeof(int)) < 0 || argint(1, &val) < 0)
+		return -1;
+	if ((uint)addr % sizeof(int) != 0)
+		return -1;
+	return futexwait((uint)addr, val);
+}
+
+int sys_futexwake(void) {
+	char *addr;
+	int n;
+
+	if (arginptr(0, &addr, sizeof(int)) < 0 || argint(1, &n) < 0)
+		return -1;
+	if ((uint)addr % sizeof(int) != 0)
+		return -1;
+	return futexwake((uint)addr, n);
+}
@@ -18,8 +18,15 @@ int screen_size;
 RGB *screen;
 RGB *screen_buf;
 
+// The back buffer and a copy of what the framebuffer holds live in
+// the top guimemsize bytes of RAM, which main() keeps from kalloc.
+uint guimemsize;
+static RGB *screen_shadow;
+static int fbfull, havesse2;
+
 void initGUI() {
 	uint GraphicMem = KERNBASE + 0x1028;
+	uint a, b, c, d;
 
 	uint baseAdd = *((uint *)GraphicMem);
 	screen = (RGB *)baseAdd;
@@ -29,7 +36,13 @@ void initGUI() {
 
 	screen_size = (SCREEN_WIDTH * SCREEN_HEIGHT) * 3;
 
-	screen_buf = (RGB *)(baseAdd + screen_size);
+	guimemsize = 2 * PGROUNDUP(screen_size);
+	screen_buf = (RGB *)P2V(PHYSTOP - guimemsize);
+	screen_shadow = (RGB *)P2V(PHYSTOP - guimemsize / 2);
+	fbfull = 1;
+	fbmapwc(baseAdd, screen_size);
+	cpuinfo(1, &a, &b, &c, &d);
+	havesse2 = (d & (1 << 26)) != 0;
 
 	mouse_color[0].G = 0;
 	mouse_color[0].B = 0;
@@ -343,6 +356,47 @@ void clearRectByCoord(RGB *buf, RGB *temp_buf, int xmin, int ymin, int xmax,
 	clearRect(buf, temp_buf, xmin, ymin, xmax - xmin, ymax - ymin);
 }
 
+static int rowsame(uint *a, uint *b, int n) {
+	int i;
+
+	for (i = 0; i < n / 4; i++)
+		if (a[i] != b[i])
+			return 0;
+	return memcmp(a + i, b + i, n % 4) == 0;
+}
+
+// Copy n bytes to the framebuffer with non-temporal stores, which
+// bypass the cache and fill whole write-combining lines.
+static void fbcopy(uint *dst, uint *src, int n) {
+	int i;
+
+	if (!havesse2) {
+		memmove(dst, src, n);
+		return;
+	}
+	for (i = 0; i < n / 4; i++)
+		asm volatile("movnti %1, %0" : "=m"(dst[i]) : "r"(src[i]));
+	memmove(dst + i, src + i, n % 4);
+}
+
+// Upload screen_buf to the framebuffer, writing only the rows that
+// differ from what was uploaded last time.
+void fbflush(void) {
+	int y, n = SCREEN_WIDTH * 3;
+	char *src = (char *)screen_buf, *old = (char *)screen_shadow;
+	char *dst = (char *)screen;
+
+	for (y = 0; y < SCREEN_HEIGHT; y++, src += n, old += n, dst += n) {
+		if (!fbfull && rowsame((uint *)src, (uint *)old, n))
+			continue;
+		memmove(old, src, n);
+		fbcopy((uint *)dst, (uint *)src, n);
+	}
+	if (havesse2)
+		asm volatile("sfence" : : : "memory");
+	fbfull = 0;
+}
+
 void drawMouse(RGB *buf, int mode, int x, int y) {
 	int i, j;
 	RGB *t;
@@ -21,6 +21,7 @@ struct {
 	struct spinlock lock;
 	int use_lock;
 	struct run *freelist;
+	uint npages; // pages handed to the allocator by kinit1/kinit2
 } kmem;
 
 // Initialization happens in two phases.
@@ -42,9 +43,14 @@ void kinit2(void *vstart, void *vend) {
 void freerange(void *vstart, void *vend) {
 	char *p;
 	p = (char *)PGROUNDUP((uint)vstart);
-	for (; p + PGSIZE <= (char *)vend; p += PGSIZE)
+	for (; p + PGSIZE <= (char *)vend; p += PGSIZE) {
 		kfree(p);
+		kmem.npages++;
+	}
 }
+
+// Return how many pages of physical memory the allocator manages.
+uint kmempages(void) { return kmem.npages; }
 // PAGEBREAK: 21
 // Free the page of physical memory pointed at by v,
 // which normally should have been returned by a
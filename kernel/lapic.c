@@ -43,12 +43,43 @@
 
 volatile uint *lapic; // Initialized in mp.c
 
+uint tscperus;		// TSC cycles per microsecond
+static uint lapicperus; // Timer counts per microsecond
+
+// The PIT runs at a fixed 1193182 Hz; channel 2 can be polled
+// through port 0x61 without taking interrupts.
+#define PIT_HZ 1193182
+#define CALUS 10000 // calibrate over 10ms
+
 // PAGEBREAK!
 static void lapicw(int index, int value) {
 	lapic[index] = value;
 	lapic[ID]; // wait for write to finish, by reading
 }
 
+// Measure the TSC and the timer's bus clock against the PIT.
+static void lapiccalibrate(void) {
+	uint latch = PIT_HZ / (1000000 / CALUS);
+	uint64 t0;
+
+	outb(0x61, (inb(0x61) & ~0x02) | 0x01); // gate on, speaker off
+	outb(0x43, 0xB0);			// channel 2, mode 0
+	outb(0x42, latch & 0xFF);
+	outb(0x42, latch >> 8);
+	lapicw(TIMER, MASKED);
+	lapicw(TICR, 0xFFFFFFFF);
+	t0 = rdtsc();
+	while ((inb(0x61) & 0x20) == 0)
+		;
+	lapicperus = (0xFFFFFFFF - lapic[TCCR]) / CALUS;
+	tscperus = (uint)(rdtsc() - t0) / CALUS;
+	lapicw(TICR, 0);
+	if (lapicperus == 0)
+		lapicperus = 1;
+	if (tscperus == 0)
+		tscperus = 1;
+}
+
 void lapicinit(void) {
 	if (!lapic)
 		return;
@@ -56,13 +87,14 @@ void lapicinit(void) {
 	// Enable local APIC; set spurious interrupt vector.
 	lapicw(SVR, ENABLE | (T_IRQ0 + IRQ_SPURIOUS));
 
-	// The timer repeatedly counts down at bus frequency
-	// from lapic[TICR] and then issues an interrupt.
-	// If xv6 cared more about precise timekeeping,
-	// TICR would be calibrated using an external time source.
+	// The timer counts down once from lapic[TICR] at bus
+	// frequency and then issues an interrupt; timerarm()
+	// reloads it for each event.
 	lapicw(TDCR, X1);
-	lapicw(TIMER, PERIODIC | (T_IRQ0 + IRQ_TIMER));
-	lapicw(TICR, 10000000);
+	if (lapicperus == 0)
+		lapiccalibrate();
+	lapicw(TIMER, T_IRQ0 + IRQ_TIMER);
+	lapicw(TICR, 0);
 
 	// Disable logical interrupt lines.
 	lapicw(LINT0, MASKED);
@@ -105,6 +137,20 @@ void lapiceoi(void) {
 		lapicw(EOI, 0);
 }
 
+// Fire this CPU's timer once after us microseconds; 0 stops it.
+void lapictimer(uint us) {
+	if (lapic)
+		lapicw(TICR, us * lapicperus);
+}
+
+// Interrupt the CPU with the given APIC ID at vector.
+void lapicipi(int apicid, int vector) {
+	lapicw(ICRHI, apicid << 24);
+	lapicw(ICRLO, FIXED | ASSERT | vector);
+	while (lapic[ICRLO] & DELIVS)
+		;
+}
+
 // Spin for a given number of microseconds.
 // On real hardware would want to tune this dynamically.
 void microdelay(int us) {}
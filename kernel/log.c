@@ -28,18 +28,24 @@
 //   block C
 //   ...
 // Log appends are synchronous.
+//
+// mkfs records the number of log blocks in the superblock (sb.nlog).
+// The kernel uses as much of it as it can keep pinned in the buffer
+// cache: at most LOGMAX data blocks, since every logged block stays
+// B_DIRTY in the cache until it has been installed.
 
 // Contents of the header block, used for both the on-disk header block
 // and to keep track in memory of logged block# before commit.
 struct logheader {
 	int n;
-	int block[LOGSIZE];
+	int block[LOGMAX];
 };
 
 struct log {
 	struct spinlock lock;
 	int start;
 	int size;
+	int cap;	 // usable data blocks: min(size - 1, LOGMAX)
 	int outstanding; // how many FS sys calls are executing.
 	int committing;	 // in commit(), please wait.
 	int dev;
@@ -59,6 +65,11 @@ void initlog(int dev) {
 	readsb(dev, &sb);
 	log.start = sb.logstart;
 	log.size = sb.nlog;
+	log.cap = log.size - 1;
+	if (log.cap > LOGMAX)
+		log.cap = LOGMAX;
+	if (log.cap < MAXOPBLOCKS)
+		panic("initlog: log too small");
 	log.dev = dev;
 	recover_from_log();
 }
@@ -85,6 +96,8 @@ static void read_head(void) {
 	struct logheader *lh = (struct logheader *)(buf->data);
 	int i;
 	log.lh.n = lh->n;
+	if (log.lh.n > log.cap)
+		panic("read_head: log larger than cache");
 	for (i = 0; i < log.lh.n; i++) {
 		log.lh.block[i] = lh->block[i];
 	}
@@ -120,7 +133,7 @@ void begin_op(void) {
 		if (log.committing) {
 			sleep(&log, &log.lock);
 		} else if (log.lh.n + (log.outstanding + 1) * MAXOPBLOCKS >
-			   LOGSIZE) {
+			   log.cap) {
 			// this op might exhaust log space; wait for commit.
 			sleep(&log, &log.lock);
 		} else {
@@ -200,7 +213,7 @@ static void commit() {
 void log_write(struct buf *b) {
 	int i;
 
-	if (log.lh.n >= LOGSIZE || log.lh.n >= log.size - 1)
+	if (log.lh.n >= log.cap)
 		panic("too big a transaction");
 	if (log.outstanding < 1)
 		panic("log_write outside of trans");
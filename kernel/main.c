@@ -16,6 +16,7 @@ int main(void) {
 	kvmalloc();
 	mpinit();
 	lapicinit();
+	timerinit();
 	seginit();
 	picinit();
 	ioapicinit();
@@ -26,10 +27,11 @@ int main(void) {
 	tvinit();
 	binit();
 	fileinit();
+	futexinit();
 	ideinit();
 	initGUI();
 	startothers();
-	kinit2(P2V(4 * 1024 * 1024), P2V(PHYSTOP));
+	kinit2(P2V(4 * 1024 * 1024), P2V(PHYSTOP - guimemsize));
 	userinit();
 	mpmain();
 }
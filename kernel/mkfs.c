@@ -47,6 +47,7 @@ void rinode(uint inum, struct dinode *ip);
 void rsect(uint sec, void *buf);
 uint ialloc(ushort type);
 void iappend(uint inum, void *p, int n);
+uint emap(struct dinode *din, uint fbn);
 
 ushort xshort(ushort x) {
 	ushort y;
@@ -76,8 +77,25 @@ int main(int argc, char *argv[]) {
 
 	static_assert(sizeof(int) == 4, "Integers must be 4 bytes!");
 
+	// Optional "-l nlog" sets the number of on-disk log blocks
+	// (header included); the kernel reads it back from the superblock.
+	if (argc >= 3 && strcmp(argv[1], "-l") == 0) {
+		nlog = atoi(argv[2]);
+		argv += 2;
+		argc -= 2;
+	}
+
 	if (argc < 2) {
-		fprintf(stderr, "Usage: mkfs fs.img files...\n");
+		fprintf(stderr, "Usage: mkfs [-l nlog] fs.img files...\n");
+		exit(1);
+	}
+
+	// One header block plus room for at least one full FS op, and the
+	// header (count + block numbers) must fit in a single block.
+	if (nlog < MAXOPBLOCKS + 1 || nlog * sizeof(int) > BSIZE) {
+		fprintf(stderr, "mkfs: log size %d out of range (%d..%lu)\n",
+			nlog, MAXOPBLOCKS + 1,
+			(unsigned long)(BSIZE / sizeof(int)));
 		exit(1);
 	}
 
@@ -101,6 +119,7 @@ int main(int argc, char *argv[]) {
 	sb.inodestart = xint(2 + nlog);
 	sb.bmapstart = xint(2 + nlog + ninodeblocks);
 	sb.checksum = 0;
+	sb.features = xint(FS_EXTENTS | FS_DIRHASH);
 
 	printf("nmeta %d (boot, super, log blocks %u inode blocks %u, bitmap "
 	       "blocks %u) blocks %d total %d\n",
@@ -187,8 +206,12 @@ int main(int argc, char *argv[]) {
 	// Fix up root inode size
 	rinode(rootino, &din);
 	off = xint(din.data.size);
-	off = ((off / BSIZE) + 1) * BSIZE;
+	off = ((off + BSIZE - 1) / BSIZE) * BSIZE;
 	din.data.size = xint(off);
+	// A single-block directory is a valid one-bucket hashed directory;
+	// the kernel splits it as it grows. Larger ones stay linear.
+	if (off <= BSIZE)
+		din.data.flags = xint(DI_DIRHASH);
 	winode(rootino, &din);
 
 	balloc(freeblock);
@@ -253,6 +276,8 @@ uint ialloc(ushort type) {
 	din.data.type = xshort(type);
 	din.data.nlink = xshort(1);
 	din.data.size = xint(0);
+	if (type == T_FILE)
+		din.data.flags = xint(DI_EXTENTS);
 	winode(inum, &din);
 	return inum;
 }
@@ -272,6 +297,37 @@ void balloc(int used) {
 
 #define min(a, b) ((a) < (b) ? (a) : (b))
 
+// Map file block fbn of an extent-mapped inode, appending a block when
+// fbn is one past the end. Files are written one at a time from
+// freeblock, so each one normally ends up as a single extent.
+uint emap(struct dinode *din, uint fbn) {
+	struct extent *e = (struct extent *)din->data.addrs;
+	uint lbn = 0;
+	int i;
+
+	for (i = 0; i < NIEXTENT && xint(e[i].len) != 0; i++) {
+		if (fbn < lbn + xint(e[i].len))
+			return xint(e[i].start) + (fbn - lbn);
+		lbn += xint(e[i].len);
+	}
+
+	if (freeblock >= (uint)(nmeta + nblocks)) {
+		fprintf(stderr, "\nOut of data blocks!\n");
+		exit(1);
+	}
+
+	if (i > 0 && xint(e[i - 1].start) + xint(e[i - 1].len) == freeblock) {
+		e[i - 1].len = xint(xint(e[i - 1].len) + 1);
+	} else if (i < NIEXTENT) {
+		e[i].start = xint(freeblock);
+		e[i].len = xint(1);
+	} else {
+		fprintf(stderr, "\nemap: too many extents\n");
+		exit(1);
+	}
+	return freeblock++;
+}
+
 void iappend(uint inum, void *xp, int n) {
 	char *p = (char *)xp;
 	uint fbn, off, n1;
@@ -294,7 +350,10 @@ void iappend(uint inum, void *xp, int n) {
 			exit(1);
 		}
 
-		if (fbn < NDIRECT) {
+		if (xint(din.data.flags) & DI_EXTENTS) {
+			x = emap(&din, fbn);
+
+		} else if (fbn < NDIRECT) {
 			if (xint(din.data.addrs[fbn]) == 0) {
 				if (freeblock >= (uint)(nmeta + nblocks)) {
 					fprintf(stderr,
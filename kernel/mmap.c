@@ -0,0 +1,268 @@
+//
+// Memory-mapped files.
+// mmap() reserves a range of the process's address space above
+// MMAPBASE and records it in p->vma[]; no pages are mapped until
+// the process touches them, when mmapfault() reads the page from
+// the inode through the buffer cache. Mappings are private: a
+// PROT_WRITE mapping can be written, but changes never reach the
+// file. Threads use their leader's regions; its vmlock keeps them
+// from changing the table or mapping a page under each other.
+//
+
+#include "defs.h"
+#include "fcntl.h"
+#include "file.h"
+#include "fs.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "param.h"
+#include "proc.h"
+#include "sleeplock.h"
+#include "spinlock.h"
+#include "stat.h"
+#include "types.h"
+#include "x86.h"
+
+// Find the region of p containing va, or 0.
+static struct vma *vmafind(struct proc *p, uint va) {
+	struct vma *v;
+
+	for (v = p->vma; v < &p->vma[NVMA]; v++)
+		if (v->f && v->start <= va && va < v->end)
+			return v;
+	return 0;
+}
+
+// Find a hole of len bytes in [MMAPBASE, KERNBASE), first fit.
+static uint vmaplace(struct proc *p, uint len) {
+	struct vma *v;
+	uint a = MMAPBASE;
+
+again:
+	if (a + len < a || a + len > KERNBASE)
+		return 0;
+	for (v = p->vma; v < &p->vma[NVMA]; v++) {
+		if (v->f && v->start < a + len && a < v->end) {
+			a = v->end;
+			goto again;
+		}
+	}
+	return a;
+}
+
+// Map in the page containing va if it belongs to a region that allows
+// the access. Returns 0 on success, -1 if the fault is a real error.
+int mmapfault(uint va, int write) {
+	struct proc *p = myproc()->leader;
+	struct vma *v, r;
+	pte_t *pte;
+	char *mem;
+	uint a;
+
+	a = PGROUNDDOWN(va);
+	acquiresleep(&p->vmlock);
+	if ((v = vmafind(p, va)) == 0 || (write && !(v->prot & PROT_WRITE)))
+		goto bad;
+	pte = walkpgdir(p->pgdir, (char *)a, 0);
+	if (pte && (*pte & PTE_P)) {
+		// another thread mapped it since this one faulted
+		releasesleep(&p->vmlock);
+		return 0;
+	}
+	r = *v;
+	r.f = filedup(v->f);
+	releasesleep(&p->vmlock);
+
+	if ((mem = kalloc()) == 0) {
+		fileclose(r.f);
+		return -1;
+	}
+	memset(mem, 0, PGSIZE);
+	ilock(r.f->ip);
+	readi(r.f->ip, mem, r.off + (a - r.start), PGSIZE);
+	iunlock(r.f->ip);
+	fileclose(r.f);
+
+	acquiresleep(&p->vmlock);
+	pte = walkpgdir(p->pgdir, (char *)a, 0);
+	if (pte && (*pte & PTE_P)) {
+		releasesleep(&p->vmlock);
+		kfree(mem);
+		return 0;
+	}
+	if (mappages(p->pgdir, (char *)a, PGSIZE, V2P(mem),
+		     PTE_U | (r.prot & PROT_WRITE ? PTE_W : 0)) < 0) {
+		releasesleep(&p->vmlock);
+		kfree(mem);
+		return -1;
+	}
+	releasesleep(&p->vmlock);
+	return 0;
+
+bad:
+	releasesleep(&p->vmlock);
+	return -1;
+}
+
+// Check that [va, va+n) lies inside one region, writable if write is
+// set, and fault it all in, so the kernel can access it directly
+// during a system call.
+int mmapcheck(uint va, int n, int write) {
+	struct proc *p = myproc()->leader;
+	struct vma *v;
+	uint a;
+
+	acquiresleep(&p->vmlock);
+	v = vmafind(p, va);
+	if (n < 0 || v == 0 || va + n > v->end ||
+	    (write && !(v->prot & PROT_WRITE))) {
+		releasesleep(&p->vmlock);
+		return -1;
+	}
+	releasesleep(&p->vmlock);
+	for (a = PGROUNDDOWN(va); a < va + n; a += PGSIZE) {
+		pte_t *pte = walkpgdir(myproc()->pgdir, (char *)a, 0);
+		if ((!pte || !(*pte & PTE_P)) && mmapfault(a, write) < 0)
+			return -1;
+	}
+	return 0;
+}
+
+// Give child np copies of p's regions and of the pages faulted in so
+// far, so private writes made before fork() are inherited.
+// The caller holds p's vmlock.
+int mmapfork(struct proc *np, struct proc *p) {
+	struct vma *v;
+	pte_t *pte;
+	char *mem;
+	uint a;
+	int i;
+
+	for (i = 0; i < NVMA; i++) {
+		v = &p->vma[i];
+		if (v->f == 0)
+			continue;
+		np->vma[i] = *v;
+		np->vma[i].f = filedup(v->f);
+		for (a = v->start; a < v->end; a += PGSIZE) {
+			pte = walkpgdir(p->pgdir, (char *)a, 0);
+			if (!pte || !(*pte & PTE_P))
+				continue;
+			if ((mem = kalloc()) == 0)
+				return -1;
+			memmove(mem, P2V(PTE_ADDR(*pte)), PGSIZE);
+			if (mappages(np->pgdir, (char *)a, PGSIZE, V2P(mem),
+				     PTE_FLAGS(*pte)) < 0) {
+				kfree(mem);
+				return -1;
+			}
+		}
+	}
+	return 0;
+}
+
+// Drop every region of p. The pages themselves belong to p->pgdir and
+// are freed with it by exec() or wait().
+void mmapclose(struct proc *p) {
+	struct vma *v;
+
+	for (v = p->vma; v < &p->vma[NVMA]; v++) {
+		if (v->f) {
+			fileclose(v->f);
+			v->f = 0;
+		}
+	}
+}
+
+int sys_mmap(void) {
+	struct proc *p = myproc()->leader;
+	struct file *f;
+	struct vma *v;
+	int fd, off, len, prot;
+	uint a;
+
+	if (argint(0, &fd) < 0 || argint(1, &off) < 0 ||
+	    argint(2, &len) < 0 || argint(3, &prot) < 0)
+		return -1;
+	if (len <= 0 || off < 0 || off % PGSIZE != 0 ||
+	    (prot & ~(PROT_READ | PROT_WRITE)) != 0)
+		return -1;
+	if ((f = fileget(fd)) == 0)
+		return -1;
+	if (f->type != FD_INODE || f->ip->type != T_FILE || !f->readable) {
+		fileclose(f);
+		return -1;
+	}
+
+	acquiresleep(&p->vmlock);
+	for (v = p->vma; v < &p->vma[NVMA]; v++)
+		if (v->f == 0)
+			break;
+	if (v == &p->vma[NVMA] || (a = vmaplace(p, PGROUNDUP(len))) == 0) {
+		releasesleep(&p->vmlock);
+		fileclose(f);
+		return -1;
+	}
+
+	v->start = a;
+	v->end = a + PGROUNDUP(len);
+	v->off = off;
+	v->prot = prot;
+	v->f = f; // takes over fileget()'s reference
+	releasesleep(&p->vmlock);
+	return a;
+}
+
+// Unmap whole pages in [addr, addr+len). A region may lose its head or
+// its tail but not a piece from the middle. Like shrinking with sbrk(),
+// this is refused while other threads might have the pages in their TLB.
+int sys_munmap(void) {
+	struct proc *p = myproc()->leader;
+	struct file *gone[NVMA];
+	struct vma *v;
+	int addr, len, i, n = 0;
+	uint s, e;
+
+	if (argint(0, &addr) < 0 || argint(1, &len) < 0)
+		return -1;
+	if (addr % PGSIZE != 0 || len <= 0)
+		return -1;
+
+	acquiresleep(&p->vmlock);
+	if (sharedvm()) {
+		releasesleep(&p->vmlock);
+		return -1;
+	}
+	for (v = p->vma; v < &p->vma[NVMA]; v++) {
+		if (v->f && v->start < addr && PGROUNDUP(addr + len) < v->end) {
+			releasesleep(&p->vmlock);
+			return -1;
+		}
+	}
+	for (v = p->vma; v < &p->vma[NVMA]; v++) {
+		if (v->f == 0)
+			continue;
+		s = (uint)addr > v->start ? (uint)addr : v->start;
+		e = PGROUNDUP(addr + len) < v->end ? PGROUNDUP(addr + len)
+						     : v->end;
+		if (s >= e)
+			continue;
+		deallocuvm(p->pgdir, e, s);
+		if (s == v->start) {
+			v->off += e - s;
+			v->start = e;
+		} else
+			v->end = s;
+		if (v->start == v->end) {
+			gone[n++] = v->f;
+			v->f = 0;
+		}
+	}
+	releasesleep(&p->vmlock);
+
+	// close once the lock is dropped; the other threads' faults wait on it
+	for (i = 0; i < n; i++)
+		fileclose(gone[i]);
+	switchuvm(myproc());
+	return 0;
+}
@@ -3,24 +3,37 @@
 #include "fs.h"
 #include "mmu.h"
 #include "param.h"
+#include "poll.h"
 #include "proc.h"
 #include "sleeplock.h"
 #include "spinlock.h"
 #include "types.h"
 
-#define PIPESIZE 512
+// The ring buffer is PIPEPAGES separately allocated pages, so copies
+// are split at page boundaries, which also covers wraparound.
+#define PIPESIZE (PIPEPAGES * PGSIZE)
 
 struct pipe {
 	struct spinlock lock;
-	char data[PIPESIZE];
+	char *page[PIPEPAGES];
 	uint nread;    // number of bytes read
 	uint nwrite;   // number of bytes written
 	int readopen;  // read fd is still open
 	int writeopen; // write fd is still open
 };
 
+static void pipefree(struct pipe *p) {
+	int i;
+
+	for (i = 0; i < PIPEPAGES; i++)
+		if (p->page[i])
+			kfree(p->page[i]);
+	kfree((char *)p);
+}
+
 int pipealloc(struct file **f0, struct file **f1) {
 	struct pipe *p;
+	int i;
 
 	p = 0;
 	*f0 = *f1 = 0;
@@ -28,6 +41,10 @@ int pipealloc(struct file **f0, struct file **f1) {
 		goto bad;
 	if ((p = (struct pipe *)kalloc()) == 0)
 		goto bad;
+	memset(p, 0, sizeof(*p));
+	for (i = 0; i < PIPEPAGES; i++)
+		if ((p->page[i] = kalloc()) == 0)
+			goto bad;
 	p->readopen = 1;
 	p->writeopen = 1;
 	p->nwrite = 0;
@@ -46,7 +63,7 @@ int pipealloc(struct file **f0, struct file **f1) {
 	// PAGEBREAK: 20
 bad:
 	if (p)
-		kfree((char *)p);
+		pipefree(p);
 	if (*f0)
 		fileclose(*f0);
 	if (*f1)
@@ -63,37 +80,65 @@ void pipeclose(struct pipe *p, int writable) {
 		p->readopen = 0;
 		wakeup(&p->nwrite);
 	}
+	pollwakeup();
 	if (p->readopen == 0 && p->writeopen == 0) {
 		release(&p->lock);
-		kfree((char *)p);
+		pipefree(p);
 	} else
 		release(&p->lock);
 }
 
+// Copy n bytes between addr and the ring starting at stream offset off.
+static void pipecopy(struct pipe *p, uint off, char *addr, int n, int in) {
+	uint o, m;
+
+	while (n > 0) {
+		o = off % PIPESIZE;
+		m = PGSIZE - o % PGSIZE;
+		if (m > n)
+			m = n;
+		if (in)
+			memmove(p->page[o / PGSIZE] + o % PGSIZE, addr, m);
+		else
+			memmove(addr, p->page[o / PGSIZE] + o % PGSIZE, m);
+		off += m;
+		addr += m;
+		n -= m;
+	}
+}
+
 // PAGEBREAK: 40
+// Readers sleep only while the pipe is empty and writers only while it
+// is full, so each side wakes the other just on those transitions.
 int pipewrite(struct pipe *p, char *addr, int n) {
-	int i;
+	int i, m;
 
 	acquire(&p->lock);
-	for (i = 0; i < n; i++) {
+	for (i = 0; i < n; i += m) {
 		while (p->nwrite == p->nread + PIPESIZE) { // DOC:
 							   // pipewrite-full
 			if (p->readopen == 0 || myproc()->killed) {
 				release(&p->lock);
 				return -1;
 			}
-			wakeup(&p->nread);
 			sleep(&p->nwrite, &p->lock); // DOC: pipewrite-sleep
 		}
-		p->data[p->nwrite++ % PIPESIZE] = addr[i];
+		m = PIPESIZE - (p->nwrite - p->nread);
+		if (m > n - i)
+			m = n - i;
+		pipecopy(p, p->nwrite, addr + i, m, 1);
+		if (p->nwrite == p->nread) {
+			wakeup(&p->nread); // DOC: pipewrite-wakeup1
+			pollwakeup();
+		}
+		p->nwrite += m;
 	}
-	wakeup(&p->nread); // DOC: pipewrite-wakeup1
 	release(&p->lock);
 	return n;
 }
 
 int piperead(struct pipe *p, char *addr, int n) {
-	int i;
+	int m;
 
 	acquire(&p->lock);
 	while (p->nread == p->nwrite && p->writeopen) { // DOC: pipe-empty
@@ -103,12 +148,35 @@ int piperead(struct pipe *p, char *addr, int n) {
 		}
 		sleep(&p->nread, &p->lock); // DOC: piperead-sleep
 	}
-	for (i = 0; i < n; i++) { // DOC: piperead-copy
-		if (p->nread == p->nwrite)
-			break;
-		addr[i] = p->data[p->nread++ % PIPESIZE];
+	m = p->nwrite - p->nread; // DOC: piperead-copy
+	if (m > n)
+		m = n;
+	pipecopy(p, p->nread, addr, m, 0);
+	if (p->nwrite == p->nread + PIPESIZE && m > 0) {
+		wakeup(&p->nwrite); // DOC: piperead-wakeup
+		pollwakeup();
+	}
+	p->nread += m;
+	release(&p->lock);
+	return m;
+}
+
+// Readiness of the read (writable == 0) or write end of p for poll().
+int pipepoll(struct pipe *p, int writable) {
+	int r = 0;
+
+	acquire(&p->lock);
+	if (writable) {
+		if (p->nwrite < p->nread + PIPESIZE)
+			r |= POLLOUT;
+		if (!p->readopen)
+			r |= POLLHUP;
+	} else {
+		if (p->nread != p->nwrite)
+			r |= POLLIN;
+		if (!p->writeopen)
+			r |= POLLHUP;
 	}
-	wakeup(&p->nwrite); // DOC: piperead-wakeup
 	release(&p->lock);
-	return i;
+	return r;
 }
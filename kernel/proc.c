@@ -4,6 +4,7 @@
 #include "mmu.h"
 #include "param.h"
 #include "spinlock.h"
+#include "traps.h"
 #include "types.h"
 #include "x86.h"
 
@@ -12,6 +13,9 @@ struct {
 	struct proc proc[NPROC];
 } ptable;
 
+// A process needs at most one, so there are as many as procs.
+static struct files filestab[NPROC];
+
 static struct proc *initproc;
 
 int nextpid = 1;
@@ -19,8 +23,80 @@ extern void forkret(void);
 extern void trapret(void);
 
 static void wakeup1(void *chan);
+static void kickidle(void);
+
+void pinit(void) {
+	struct proc *p;
+
+	struct files *fs;
+
+	initticketlock(&ptable.lock, "ptable");
+	for (p = ptable.proc; p < &ptable.proc[NPROC]; p++)
+		initsleeplock(&p->vmlock, "vm");
+	for (fs = filestab; fs < &filestab[NPROC]; fs++)
+		initlock(&fs->lock, "files");
+}
+
+// Give a new process copies of the open files and current directory
+// in fs, or an empty set if fs is 0. Return 0 if there is no room.
+static struct files *filesdup(struct files *fs) {
+	struct files *nf;
+	int i;
+
+	acquire(&ptable.lock);
+	for (nf = filestab; nf < &filestab[NPROC]; nf++)
+		if (nf->ref == 0)
+			break;
+	if (nf == &filestab[NPROC]) {
+		release(&ptable.lock);
+		return 0;
+	}
+	nf->ref = 1;
+	release(&ptable.lock);
+
+	memset(nf->ofile, 0, sizeof(nf->ofile));
+	nf->cwd = 0;
+	if (fs == 0)
+		return nf;
+	acquire(&fs->lock);
+	for (i = 0; i < NOFILE; i++)
+		if (fs->ofile[i])
+			nf->ofile[i] = filedup(fs->ofile[i]);
+	nf->cwd = idup(fs->cwd);
+	release(&fs->lock);
+	return nf;
+}
 
-void pinit(void) { initlock(&ptable.lock, "ptable"); }
+// Drop the current process's use of its files; the last one to go
+// closes them, and only then lets filesdup() reuse the slot.
+static void filesput(void) {
+	struct proc *curproc = myproc();
+	struct files *fs = curproc->files;
+	int fd, last;
+
+	acquire(&ptable.lock);
+	if (!(last = fs->ref == 1))
+		fs->ref--;
+	curproc->files = 0;
+	release(&ptable.lock);
+	if (!last)
+		return;
+
+	for (fd = 0; fd < NOFILE; fd++) {
+		if (fs->ofile[fd]) {
+			fileclose(fs->ofile[fd]);
+			fs->ofile[fd] = 0;
+		}
+	}
+	begin_op();
+	iput(fs->cwd);
+	end_op();
+	fs->cwd = 0;
+
+	acquire(&ptable.lock);
+	fs->ref = 0;
+	release(&ptable.lock);
+}
 
 // Must be called with interrupts disabled
 int cpuid() { return mycpu() - cpus; }
@@ -76,6 +152,7 @@ static struct proc *allocproc(void) {
 found:
 	p->state = EMBRYO;
 	p->pid = nextpid++;
+	p->leader = p;
 
 	release(&ptable.lock);
 
@@ -126,7 +203,9 @@ void userinit(void) {
 	p->tf->eip = 0; // beginning of initcode.S
 
 	safestrcpy(p->name, "initcode", sizeof(p->name));
-	p->cwd = namei("/");
+	if ((p->files = filesdup(0)) == 0)
+		panic("userinit: files");
+	p->files->cwd = namei("/");
 
 	// this assignment to p->state lets other cores
 	// run this process. the acquire forces the above
@@ -139,30 +218,65 @@ void userinit(void) {
 	release(&ptable.lock);
 }
 
+// Return 1 if threads other than the current one use its memory.
+// The caller holds the leader's vmlock, so clone() can't add one.
+int sharedvm(void) {
+	struct proc *curproc = myproc();
+	struct proc *p;
+	int n = 0;
+
+	acquire(&ptable.lock);
+	for (p = ptable.proc; p < &ptable.proc[NPROC]; p++)
+		if (p != curproc && p->leader == curproc->leader &&
+		    p->state != UNUSED && p->state != ZOMBIE)
+			n = 1;
+	release(&ptable.lock);
+	return n;
+}
+
 // Grow current process's memory by n bytes.
-// Return 0 on success, -1 on failure.
+// Return the old size on success, -1 on failure.
+// Threads share the memory, so all of them see the new size; the
+// leader's vmlock keeps two of them from changing it at once. Another
+// CPU could still hold TLB entries for pages given back, so memory
+// is only shrunk while no other thread is running in it.
 int growproc(int n) {
-	uint sz;
+	uint sz, old;
 	struct proc *curproc = myproc();
+	struct proc *p;
 
-	sz = curproc->sz;
+	acquiresleep(&curproc->leader->vmlock);
+	sz = old = curproc->sz;
 	if (n > 0) {
+		if (sz + n > MMAPBASE)
+			goto bad;
 		if ((sz = allocuvm(curproc->pgdir, sz, sz + n)) == 0)
-			return -1;
+			goto bad;
 	} else if (n < 0) {
+		if (sharedvm())
+			goto bad;
 		if ((sz = deallocuvm(curproc->pgdir, sz, sz + n)) == 0)
-			return -1;
+			goto bad;
 	}
-	curproc->sz = sz;
+	acquire(&ptable.lock);
+	for (p = ptable.proc; p < &ptable.proc[NPROC]; p++)
+		if (p->state != UNUSED && p->leader == curproc->leader)
+			p->sz = sz;
+	release(&ptable.lock);
+	releasesleep(&curproc->leader->vmlock);
 	switchuvm(curproc);
-	return 0;
+	return old;
+
+bad:
+	releasesleep(&curproc->leader->vmlock);
+	return -1;
 }
 
 // Create a new process copying p as the parent.
 // Sets up stack to return as if from system call.
 // Caller must set state of returned proc to RUNNABLE.
 int fork(void) {
-	int i, pid;
+	int pid;
 	struct proc *np;
 	struct proc *curproc = myproc();
 
@@ -171,24 +285,90 @@ int fork(void) {
 		return -1;
 	}
 
-	// Copy process state from proc.
+	// Copy process state from proc. Sibling threads may not change
+	// the memory while it is copied.
+	acquiresleep(&curproc->leader->vmlock);
 	if ((np->pgdir = copyuvm(curproc->pgdir, curproc->sz)) == 0) {
+		releasesleep(&curproc->leader->vmlock);
 		kfree(np->kstack);
 		np->kstack = 0;
 		np->state = UNUSED;
 		return -1;
 	}
+	if (mmapfork(np, curproc->leader) < 0) {
+		releasesleep(&curproc->leader->vmlock);
+		goto bad;
+	}
 	np->sz = curproc->sz;
+	releasesleep(&curproc->leader->vmlock);
+	if ((np->files = filesdup(curproc->files)) == 0)
+		goto bad;
 	np->parent = curproc;
 	*np->tf = *curproc->tf;
 
 	// Clear %eax so that fork returns 0 in the child.
 	np->tf->eax = 0;
 
-	for (i = 0; i < NOFILE; i++)
-		if (curproc->ofile[i])
-			np->ofile[i] = filedup(curproc->ofile[i]);
-	np->cwd = idup(curproc->cwd);
+	safestrcpy(np->name, curproc->name, sizeof(curproc->name));
+
+	pid = np->pid;
+
+	acquire(&ptable.lock);
+
+	np->state = RUNNABLE;
+	kickidle();
+
+	release(&ptable.lock);
+
+	return pid;
+
+bad:
+	mmapclose(np);
+	freevm(np->pgdir);
+	kfree(np->kstack);
+	np->kstack = 0;
+	np->state = UNUSED;
+	return -1;
+}
+
+// Create a thread of the current process: it shares the address
+// space and starts at fn(arg) on the user stack [stack, stack+size).
+// It shares the open files and current directory too.
+int clone(uint fn, uint arg, uint stack, int size) {
+	int pid;
+	uint sp, ustack[2];
+	struct proc *np;
+	struct proc *curproc = myproc();
+
+	if ((np = allocproc()) == 0)
+		return -1;
+
+	// Hold the vmlock until the thread is runnable, so a shrink that
+	// found no other threads can't be racing with a new one.
+	acquiresleep(&curproc->leader->vmlock);
+
+	// Fake return PC: fn must call exit() rather than return.
+	sp = (stack + size) & ~3;
+	ustack[0] = 0xffffffff;
+	ustack[1] = arg;
+	sp -= sizeof(ustack);
+	if (copyout(curproc->pgdir, sp, ustack, sizeof(ustack)) < 0) {
+		releasesleep(&curproc->leader->vmlock);
+		kfree(np->kstack);
+		np->kstack = 0;
+		np->state = UNUSED;
+		return -1;
+	}
+
+	np->pgdir = curproc->pgdir;
+	np->leader = curproc->leader;
+	np->parent = curproc->leader;
+	np->ustack = stack;
+	*np->tf = *curproc->tf;
+	np->tf->eax = 0;
+	np->tf->esp = sp;
+	np->tf->eip = fn;
+	np->files = curproc->files;
 
 	safestrcpy(np->name, curproc->name, sizeof(curproc->name));
 
@@ -196,36 +376,114 @@ int fork(void) {
 
 	acquire(&ptable.lock);
 
+	np->sz = curproc->sz;
+	np->files->ref++;
 	np->state = RUNNABLE;
+	kickidle();
 
 	release(&ptable.lock);
+	releasesleep(&curproc->leader->vmlock);
 
 	return pid;
 }
 
+// Free the slot of zombie thread p; its memory is the leader's.
+// The ptable lock must be held.
+static void freethread(struct proc *p) {
+	kfree(p->kstack);
+	p->kstack = 0;
+	p->pid = 0;
+	p->parent = 0;
+	p->name[0] = 0;
+	p->killed = 0;
+	p->state = UNUSED;
+}
+
+// Wait for a thread of the current process to exit, store the user
+// stack it was given in *stack and return its pid.
+// Return -1 if the process has no other threads.
+int join(uint *stack) {
+	struct proc *p;
+	int havekids, pid;
+	struct proc *curproc = myproc();
+
+	acquire(&ptable.lock);
+	for (;;) {
+		havekids = 0;
+		for (p = ptable.proc; p < &ptable.proc[NPROC]; p++) {
+			if (p->state == UNUSED || p == curproc ||
+			    p->leader == p || p->leader != curproc->leader)
+				continue;
+			havekids = 1;
+			if (p->state == ZOMBIE) {
+				pid = p->pid;
+				*stack = p->ustack;
+				freethread(p);
+				release(&ptable.lock);
+				return pid;
+			}
+		}
+
+		if (!havekids || curproc->killed) {
+			release(&ptable.lock);
+			return -1;
+		}
+
+		// Exiting threads wake their leader.
+		sleep(curproc->leader, &ptable.lock);
+	}
+}
+
+// Kill the other threads of the current process, which must be their
+// leader, and wait until they are gone: exit() and exec() are about to
+// free the memory they run in.
+void killthreads(void) {
+	struct proc *p;
+	struct proc *curproc = myproc();
+	int n;
+
+	acquire(&ptable.lock);
+	for (;;) {
+		n = 0;
+		for (p = ptable.proc; p < &ptable.proc[NPROC]; p++) {
+			if (p->state == UNUSED || p == curproc ||
+			    p->leader != curproc)
+				continue;
+			if (p->state == ZOMBIE) {
+				freethread(p);
+				continue;
+			}
+			n++;
+			p->killed = 1;
+			if (p->state == SLEEPING) {
+				p->state = RUNNABLE;
+				kickidle();
+			}
+		}
+		if (n == 0)
+			break;
+		sleep(curproc, &ptable.lock);
+	}
+	release(&ptable.lock);
+}
+
 // Exit the current process.  Does not return.
 // An exited process remains in the zombie state
 // until its parent calls wait() to find out it exited.
+// A process takes its threads with it; a thread exits alone.
 void exit(void) {
 	struct proc *curproc = myproc();
 	struct proc *p;
-	int fd;
 
 	if (curproc == initproc)
 		panic("init exiting");
 
-	// Close all open files.
-	for (fd = 0; fd < NOFILE; fd++) {
-		if (curproc->ofile[fd]) {
-			fileclose(curproc->ofile[fd]);
-			curproc->ofile[fd] = 0;
-		}
-	}
+	if (curproc->leader == curproc)
+		killthreads();
 
-	begin_op();
-	iput(curproc->cwd);
-	end_op();
-	curproc->cwd = 0;
+	// Close all open files.
+	mmapclose(curproc);
+	filesput();
 
 	acquire(&ptable.lock);
 
@@ -259,7 +517,8 @@ int wait(void) {
 		// Scan through table looking for exited children.
 		havekids = 0;
 		for (p = ptable.proc; p < &ptable.proc[NPROC]; p++) {
-			if (p->parent != curproc)
+			// threads are reaped by join() or their leader's exit
+			if (p->parent != curproc || p->leader != p)
 				continue;
 			havekids = 1;
 			if (p->state == ZOMBIE) {
@@ -300,6 +559,7 @@ int wait(void) {
 void scheduler(void) {
 	struct proc *p;
 	struct cpu *c = mycpu();
+	int ran;
 	c->proc = 0;
 
 	for (;;) {
@@ -307,6 +567,7 @@ void scheduler(void) {
 		sti();
 
 		// Loop over process table looking for process to run.
+		ran = 0;
 		acquire(&ptable.lock);
 		for (p = ptable.proc; p < &ptable.proc[NPROC]; p++) {
 			if (p->state != RUNNABLE)
@@ -318,6 +579,7 @@ void scheduler(void) {
 			c->proc = p;
 			switchuvm(p);
 			p->state = RUNNING;
+			timerarm();
 
 			swtch(&(c->scheduler), p->context);
 			switchkvm();
@@ -326,8 +588,22 @@ void scheduler(void) {
 			// It should have changed its p->state before coming
 			// back.
 			c->proc = 0;
+			ran = 1;
 		}
+		if (!ran)
+			c->idle = 1;
 		release(&ptable.lock);
+
+		// Nothing to run: halt with the timer armed only for
+		// pending hrtimers. Whoever makes a process runnable
+		// clears c->idle and interrupts us.
+		if (!ran) {
+			timerarm();
+			cli();
+			if (c->idle)
+				asm volatile("sti; hlt");
+			c->idle = 0;
+		}
 	}
 }
 
@@ -426,8 +702,25 @@ static void wakeup1(void *chan) {
 	struct proc *p;
 
 	for (p = ptable.proc; p < &ptable.proc[NPROC]; p++)
-		if (p->state == SLEEPING && p->chan == chan)
+		if (p->state == SLEEPING && p->chan == chan) {
 			p->state = RUNNABLE;
+			kickidle();
+		}
+}
+
+// Get an idle CPU to look for the process just made runnable.
+// The ptable lock must be held.
+static void kickidle(void) {
+	struct cpu *c;
+
+	for (c = cpus; c < &cpus[ncpu]; c++) {
+		if (!c->idle)
+			continue;
+		c->idle = 0;
+		if (c != mycpu())
+			lapicipi(c->apicid, T_IRQ0 + IRQ_WAKE);
+		return;
+	}
 }
 
 // Wake up all processes sleeping on chan.
@@ -448,8 +741,10 @@ int kill(int pid) {
 		if (p->pid == pid) {
 			p->killed = 1;
 			// Wake process from sleep if necessary.
-			if (p->state == SLEEPING)
+			if (p->state == SLEEPING) {
 				p->state = RUNNABLE;
+				kickidle();
+			}
 			release(&ptable.lock);
 			return 0;
 		}
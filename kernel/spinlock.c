@@ -2,6 +2,7 @@
 
 #include "spinlock.h"
 #include "defs.h"
+#include "lockstat.h"
 #include "memlayout.h"
 #include "mmu.h"
 #include "param.h"
@@ -9,10 +10,76 @@
 #include "types.h"
 #include "x86.h"
 
+#ifdef LOCKSTAT
+// Locks are grouped by name, so the per-pipe and per-buffer locks each
+// show up once. Counters are updated atomically; hold times of locks
+// that share a class can race and are approximate.
+#define NLOCKCLASS 64
+
+struct lockclass {
+	struct lockstat st;
+	unsigned long long hold_total;
+};
+
+static struct lockclass lockclass[NLOCKCLASS];
+static uint nlockclass;
+static uint lockclasslock;
+
+static struct lockclass *lockclassof(char *name) {
+	struct lockclass *c;
+	uint i;
+
+	while (xchg(&lockclasslock, 1) != 0)
+		pause();
+	for (i = 0; i < nlockclass; i++)
+		if (strncmp(lockclass[i].st.name, name,
+			    sizeof(lockclass[i].st.name) - 1) == 0)
+			break;
+	c = 0;
+	if (i < NLOCKCLASS) {
+		c = &lockclass[i];
+		if (i == nlockclass) {
+			safestrcpy(c->st.name, name, sizeof(c->st.name));
+			nlockclass++;
+		}
+	}
+	xchg(&lockclasslock, 0);
+	return c;
+}
+#endif
+
+// Copy up to n lock classes to st; returns how many, or -1 if the
+// kernel does not gather statistics.
+int lockstats(struct lockstat *st, int n) {
+#ifdef LOCKSTAT
+	int i;
+
+	for (i = 0; i < n && i < nlockclass; i++) {
+		st[i] = lockclass[i].st;
+		st[i].hold_kcycles = lockclass[i].hold_total >> 10;
+	}
+	return i;
+#else
+	return -1;
+#endif
+}
+
 void initlock(struct spinlock *lk, char *name) {
 	lk->name = name;
 	lk->locked = 0;
+	lk->fair = 0;
+	lk->next = lk->owner = 0;
 	lk->cpu = 0;
+#ifdef LOCKSTAT
+	lk->stat = lockclassof(name);
+#endif
+}
+
+// Like initlock, but waiters are served first come, first served, so a
+// heavily contended lock cannot starve one CPU.
+void initticketlock(struct spinlock *lk, char *name) {
+	initlock(lk, name);
+	lk->fair = 1;
 }
 
 // Acquire the lock.
@@ -20,30 +87,74 @@ void initlock(struct spinlock *lk, char *name) {
 // Holding a lock for a long time may cause
 // other CPUs to waste time spinning to acquire it.
 void acquire(struct spinlock *lk) {
+	struct cpu *c;
+	ushort t;
+	uint spins = 0;
+
 	pushcli(); // disable interrupts to avoid deadlock.
-	if (holding(lk))
+	c = mycpu();
+	if (lk->locked && lk->cpu == c)
 		panic("acquire");
 
-	// The xchg is atomic.
-	while (xchg(&lk->locked, 1) != 0)
-		;
+	if (lk->fair) {
+		t = __sync_fetch_and_add(&lk->next, 1);
+		while (*(volatile ushort *)&lk->owner != t) {
+			pause();
+			spins++;
+		}
+		lk->locked = 1;
+	} else {
+		// Spin on a plain load and only retry the atomic xchg once
+		// the lock looks free, so waiters do not keep stealing the
+		// cache line from the holder.
+		while (xchg(&lk->locked, 1) != 0) {
+			while (*(volatile uint *)&lk->locked) {
+				pause();
+				spins++;
+			}
+		}
+	}
 
 	// Tell the C compiler and the processor to not move loads or stores
 	// past this point, to ensure that the critical section's memory
 	// references happen after the lock is acquired.
 	__sync_synchronize();
 
+	lk->cpu = c;
+#ifdef LOCKSTAT
+	if (lk->stat) {
+		__sync_fetch_and_add(&lk->stat->st.nacquire, 1);
+		if (spins) {
+			__sync_fetch_and_add(&lk->stat->st.ncontend, 1);
+			__sync_fetch_and_add(&lk->stat->st.nspin, spins);
+		}
+		lk->tacq = rdtsc();
+	}
+#else
+	(void)spins;
+#endif
+#ifdef LOCKDEBUG
 	// Record info about lock acquisition for debugging.
-	lk->cpu = mycpu();
 	getcallerpcs(&lk, lk->pcs);
+#endif
 }
 
 // Release the lock.
 void release(struct spinlock *lk) {
-	if (!holding(lk))
+	if (!lk->locked || lk->cpu != mycpu())
 		panic("release");
 
+#ifdef LOCKSTAT
+	if (lk->stat) {
+		unsigned long long held = rdtsc() - lk->tacq;
+		lk->stat->hold_total += held;
+		if (held > lk->stat->st.hold_max)
+			lk->stat->st.hold_max = held;
+	}
+#endif
+#ifdef LOCKDEBUG
 	lk->pcs[0] = 0;
+#endif
 	lk->cpu = 0;
 
 	// Tell the C compiler and the processor to not move loads or stores
@@ -56,7 +167,12 @@ void release(struct spinlock *lk) {
 	// Release the lock, equivalent to lk->locked = 0.
 	// This code can't use a C assignment, since it might
 	// not be atomic. A real OS would use C atomics here.
-	asm volatile("movl $0, %0" : "+m"(lk->locked) :);
+	// The "memory" clobber keeps the compiler from moving the
+	// owner++ hand-off above it: the next ticket holder sets
+	// locked, and this store must not land after that.
+	asm volatile("movl $0, %0" : "+m"(lk->locked) : : "memory");
+	if (lk->fair)
+		lk->owner++; // only the holder writes owner
 
 	popcli();
 }
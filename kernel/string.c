@@ -1,15 +1,6 @@
 #include "types.h"
 #include "x86.h"
 
-void *memset(void *dst, int c, uint n) {
-	if ((int)dst % 4 == 0 && n % 4 == 0) {
-		c &= 0xFF;
-		stosl(dst, (c << 24) | (c << 16) | (c << 8) | c, n / 4);
-	} else
-		stosb(dst, c, n);
-	return dst;
-}
-
 int memcmp(const void *v1, const void *v2, uint n) {
 	const uchar *s1, *s2;
 
@@ -24,28 +15,7 @@ int memcmp(const void *v1, const void *v2, uint n) {
 	return 0;
 }
 
-void *memmove(void *dst, const void *src, uint n) {
-	const char *s;
-	char *d;
-
-	s = src;
-	d = dst;
-	if (s < d && s + n > d) {
-		s += n;
-		d += n;
-		while (n-- > 0)
-			*--d = *--s;
-	} else
-		while (n-- > 0)
-			*d++ = *s++;
-
-	return dst;
-}
-
-// memcpy exists to placate GCC.  Use memmove.
-void *memcpy(void *dst, const void *src, uint n) {
-	return memmove(dst, src, n);
-}
+// memmove, memcpy and memset are in memops.S.
 
 int strncmp(const char *p, const char *q, uint n) {
 	while (n > 0 && *p && *p == *q)
@@ -36,20 +36,31 @@ int argint(int n, int *ip) {
 	return fetchint((myproc()->tf->esp) + 4 + 4 * n, ip);
 }
 
-// Helper to get the n-th system call argument as a pointer.
-// Check if the pointer and the data it points to are within the process's
-// memory.
-int argptr(int n, char **pp, int size) {
+// Fetch the n-th system call argument as a pointer to size bytes in
+// the process's memory that the kernel may write if write is set. The
+// kernel runs without CR0.WP, so it must check that itself.
+static int argbuf(int n, char **pp, int size, int write) {
 	int i;
 	struct proc *curproc = myproc();
 	if (argint(n, &i) < 0)
 		return -1;
-	if (size < 0 || (uint)i >= curproc->sz || (uint)i + size > curproc->sz)
+	if (size < 0)
+		return -1;
+	if (((uint)i >= curproc->sz || (uint)i + size > curproc->sz) &&
+	    mmapcheck(i, size, write) < 0)
 		return -1;
 	*pp = (char *)i;
 	return 0;
 }
 
+// Helper to get the n-th system call argument as a pointer.
+// Check if the pointer and the data it points to are within the process's
+// memory, and writable, since the system call may store through it.
+int argptr(int n, char **pp, int size) { return argbuf(n, pp, size, 1); }
+
+// Like argptr, for memory the system call only reads.
+int arginptr(int n, char **pp, int size) { return argbuf(n, pp, size, 0); }
+
 // Helper to get the n-th system call argument as a string pointer.
 int argstr(int n, char **pp) {
 	int addr;
@@ -94,6 +105,18 @@ extern int sys_halt(void);
 extern int sys_reboot(void);
 extern int sys_get_rtc_time(void);
 extern int sys_get_rtc_date(void);
+extern int sys_splice(void);
+extern int sys_mmap(void);
+extern int sys_munmap(void);
+extern int sys_poll(void);
+extern int sys_lockstat(void);
+extern int sys_usleep(void);
+extern int sys_uptimeus(void);
+extern int sys_getdents(void);
+extern int sys_clone(void);
+extern int sys_join(void);
+extern int sys_futexwait(void);
+extern int sys_futexwake(void);
 
 static int (*syscalls[])(void) = {
 	[SYS_fork] sys_fork,
@@ -131,6 +154,18 @@ static int (*syscalls[])(void) = {
 	[SYS_reboot] sys_reboot,
 	[SYS_get_rtc_time] sys_get_rtc_time,
 	[SYS_get_rtc_date] sys_get_rtc_date,
+	[SYS_splice] sys_splice,
+	[SYS_mmap] sys_mmap,
+	[SYS_munmap] sys_munmap,
+	[SYS_poll] sys_poll,
+	[SYS_lockstat] sys_lockstat,
+	[SYS_usleep] sys_usleep,
+	[SYS_uptimeus] sys_uptimeus,
+	[SYS_getdents] sys_getdents,
+	[SYS_clone] sys_clone,
+	[SYS_join] sys_join,
+	[SYS_futexwait] sys_futexwait,
+	[SYS_futexwake] sys_futexwake,
 };
 
 void syscall(void) {
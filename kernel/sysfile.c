@@ -10,6 +10,7 @@
 #include "fs.h"
 #include "mmu.h"
 #include "param.h"
+#include "poll.h"
 #include "proc.h"
 #include "sleeplock.h"
 #include "spinlock.h"
@@ -17,34 +18,31 @@
 #include "types.h"
 
 // Fetch the nth word-sized system call argument as a file descriptor
-// and return both the descriptor and the corresponding struct file.
-static int argfd(int n, int *pfd, struct file **pf) {
+// and return the corresponding struct file, with a reference the
+// caller drops with fileclose(); see fileget().
+static int argfd(int n, struct file **pf) {
 	int fd;
-	struct file *f;
 
-	if (argint(n, &fd) < 0)
-		return -1;
-	if (fd < 0 || fd >= NOFILE || (f = myproc()->ofile[fd]) == 0)
+	if (argint(n, &fd) < 0 || (*pf = fileget(fd)) == 0)
 		return -1;
-	if (pfd)
-		*pfd = fd;
-	if (pf)
-		*pf = f;
 	return 0;
 }
 
 // Allocate a file descriptor for the given file.
 // Takes over file reference from caller on success.
 static int fdalloc(struct file *f) {
+	struct files *fs = myproc()->files;
 	int fd;
-	struct proc *curproc = myproc();
 
+	acquire(&fs->lock);
 	for (fd = 0; fd < NOFILE; fd++) {
-		if (curproc->ofile[fd] == 0) {
-			curproc->ofile[fd] = f;
+		if (fs->ofile[fd] == 0) {
+			fs->ofile[fd] = f;
+			release(&fs->lock);
 			return fd;
 		}
 	}
+	release(&fs->lock);
 	return -1;
 }
 
@@ -52,41 +50,94 @@ int sys_dup(void) {
 	struct file *f;
 	int fd;
 
-	if (argfd(0, 0, &f) < 0)
+	if (argfd(0, &f) < 0)
 		return -1;
 	if ((fd = fdalloc(f)) < 0)
-		return -1;
-	filedup(f);
+		fileclose(f);
 	return fd;
 }
 
 int sys_read(void) {
 	struct file *f;
-	int n;
+	int n, r = -1;
 	char *p;
 
-	if (argfd(0, 0, &f) < 0 || argint(2, &n) < 0 || argptr(1, &p, n) < 0)
+	if (argfd(0, &f) < 0)
 		return -1;
-	return fileread(f, p, n);
+	if (argint(2, &n) >= 0 && argptr(1, &p, n) >= 0)
+		r = fileread(f, p, n);
+	fileclose(f);
+	return r;
 }
 
 int sys_write(void) {
 	struct file *f;
-	int n;
+	int n, r = -1;
+	char *p;
+
+	if (argfd(0, &f) < 0)
+		return -1;
+	if (argint(2, &n) >= 0 && arginptr(1, &p, n) >= 0)
+		r = filewrite(f, p, n);
+	fileclose(f);
+	return r;
+}
+
+int sys_splice(void) {
+	struct file *fin, *fout;
+	int n, r = -1;
+
+	if (argfd(0, &fin) < 0)
+		return -1;
+	if (argfd(1, &fout) < 0) {
+		fileclose(fin);
+		return -1;
+	}
+	if (argint(2, &n) >= 0)
+		r = filesplice(fin, fout, n);
+	fileclose(fout);
+	fileclose(fin);
+	return r;
+}
+
+int sys_poll(void) {
+	struct pollfd *fds;
+	int n, timeout;
+
+	if (argint(1, &n) < 0 || n < 0 || n > 2 * NOFILE ||
+	    argptr(0, (char **)&fds, n * sizeof(*fds)) < 0 ||
+	    argint(2, &timeout) < 0)
+		return -1;
+	return pollwait(fds, n, timeout);
+}
+
+int sys_getdents(void) {
+	struct file *f;
 	char *p;
+	int n, flags, r = -1;
 
-	if (argfd(0, 0, &f) < 0 || argint(2, &n) < 0 || argptr(1, &p, n) < 0)
+	if (argfd(0, &f) < 0)
 		return -1;
-	return filewrite(f, p, n);
+	if (argint(2, &n) >= 0 && n >= 0 && argptr(1, &p, n) >= 0 &&
+	    argint(3, &flags) >= 0)
+		r = filegetdents(f, p, n, flags);
+	fileclose(f);
+	return r;
 }
 
 int sys_close(void) {
-	int fd;
+	struct files *fs = myproc()->files;
 	struct file *f;
+	int fd;
 
-	if (argfd(0, &fd, &f) < 0)
+	if (argint(0, &fd) < 0 || fd < 0 || fd >= NOFILE)
+		return -1;
+	acquire(&fs->lock);
+	f = fs->ofile[fd];
+	fs->ofile[fd] = 0;
+	release(&fs->lock);
+	if (f == 0)
 		return -1;
-	myproc()->ofile[fd] = 0;
 	fileclose(f);
 	return 0;
 }
@@ -94,10 +145,14 @@ int sys_close(void) {
 int sys_fstat(void) {
 	struct file *f;
 	struct stat *st;
+	int r = -1;
 
-	if (argfd(0, 0, &f) < 0 || argptr(1, (void *)&st, sizeof(*st)) < 0)
+	if (argfd(0, &f) < 0)
 		return -1;
-	return filestat(f, st);
+	if (argptr(1, (void *)&st, sizeof(*st)) >= 0)
+		r = filestat(f, st);
+	fileclose(f);
+	return r;
 }
 
 // Create the path new as a link to the same inode as old.
@@ -165,7 +220,6 @@ static int isdirempty(struct inode *dp) {
 // PAGEBREAK!
 int sys_unlink(void) {
 	struct inode *ip, *dp;
-	struct dirent de;
 	char name[DIRSIZ], *path;
 	uint off;
 
@@ -195,9 +249,7 @@ int sys_unlink(void) {
 		goto bad;
 	}
 
-	memset(&de, 0, sizeof(de));
-	if (writei(dp, (char *)&de, off, sizeof(de)) != sizeof(de))
-		panic("unlink: writei");
+	dirunlink(dp, off);
 	if (ip->type == T_DIR) {
 		dp->nlink--;
 		iupdate(dp);
@@ -291,9 +343,7 @@ int sys_open(void) {
 		}
 	}
 
-	if ((f = filealloc()) == 0 || (fd = fdalloc(f)) < 0) {
-		if (f)
-			fileclose(f);
+	if ((f = filealloc()) == 0) {
 		iunlockput(ip);
 		end_op();
 		return -1;
@@ -301,11 +351,14 @@ int sys_open(void) {
 	iunlock(ip);
 	end_op();
 
+	// Fill f in before a thread sharing the descriptors can see it.
 	f->type = FD_INODE;
 	f->ip = ip;
 	f->off = 0;
 	f->readable = !(omode & O_WRONLY);
 	f->writable = (omode & O_WRONLY) || (omode & O_RDWR);
+	if ((fd = fdalloc(f)) < 0)
+		fileclose(f);
 	return fd;
 }
 
@@ -342,8 +395,8 @@ int sys_mknod(void) {
 
 int sys_chdir(void) {
 	char *path;
-	struct inode *ip;
-	struct proc *curproc = myproc();
+	struct inode *ip, *old;
+	struct files *fs = myproc()->files;
 
 	begin_op();
 	if (argstr(0, &path) < 0 || (ip = namei(path)) == 0) {
@@ -357,9 +410,12 @@ int sys_chdir(void) {
 		return -1;
 	}
 	iunlock(ip);
-	iput(curproc->cwd);
+	acquire(&fs->lock);
+	old = fs->cwd;
+	fs->cwd = ip;
+	release(&fs->lock);
+	iput(old);
 	end_op();
-	curproc->cwd = ip;
 	return 0;
 }
 
@@ -390,6 +446,7 @@ int sys_exec(void) {
 int sys_pipe(void) {
 	int *fd;
 	struct file *rf, *wf;
+	struct files *fs = myproc()->files;
 	int fd0, fd1;
 
 	if (argptr(0, (void *)&fd, 2 * sizeof(fd[0])) < 0)
@@ -398,9 +455,17 @@ int sys_pipe(void) {
 		return -1;
 	fd0 = -1;
 	if ((fd0 = fdalloc(rf)) < 0 || (fd1 = fdalloc(wf)) < 0) {
-		if (fd0 >= 0)
-			myproc()->ofile[fd0] = 0;
-		fileclose(rf);
+		if (fd0 >= 0) {
+			// unless another thread has closed it already
+			acquire(&fs->lock);
+			if (fs->ofile[fd0] == rf)
+				fs->ofile[fd0] = 0;
+			else
+				rf = 0;
+			release(&fs->lock);
+		}
+		if (rf)
+			fileclose(rf);
 		fileclose(wf);
 		return -1;
 	}
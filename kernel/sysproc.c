@@ -1,5 +1,6 @@
 #include "date.h"
 #include "defs.h"
+#include "lockstat.h"
 #include "memlayout.h"
 #include "mmu.h"
 #include "param.h"
@@ -17,6 +18,29 @@ int sys_exit(void) {
 
 int sys_wait(void) { return wait(); }
 
+int sys_clone(void) {
+	int fn, arg, size;
+	char *stack;
+
+	if (argint(0, &fn) < 0 || argint(1, &arg) < 0 ||
+	    argint(3, &size) < 0 || size < (int)(2 * sizeof(uint)) ||
+	    argptr(2, &stack, size) < 0)
+		return -1;
+	return clone(fn, arg, (uint)stack, size);
+}
+
+int sys_join(void) {
+	uint *ustack, stack;
+	int pid;
+
+	if (argptr(0, (char **)&ustack, sizeof(*ustack)) < 0)
+		return -1;
+	if ((pid = join(&stack)) < 0)
+		return -1;
+	*ustack = stack;
+	return pid;
+}
+
 int sys_kill(void) {
 	int pid;
 
@@ -28,45 +52,48 @@ int sys_kill(void) {
 int sys_getpid(void) { return myproc()->pid; }
 
 int sys_sbrk(void) {
-	int addr;
 	int n;
 
 	if (argint(0, &n) < 0)
 		return -1;
-	addr = myproc()->sz;
-	if (growproc(n) < 0)
-		return -1;
-	return addr;
+	return growproc(n);
 }
 
 int sys_sleep(void) {
 	int n;
-	uint ticks0;
 
 	if (argint(0, &n) < 0)
 		return -1;
-	acquire(&tickslock);
-	ticks0 = ticks;
-	while (ticks - ticks0 < n) {
-		if (myproc()->killed) {
-			release(&tickslock);
-			return -1;
-		}
-		sleep(&ticks, &tickslock);
-	}
-	release(&tickslock);
-	return 0;
+	if (n <= 0)
+		return myproc()->killed ? -1 : 0;
+	return hrsleep(hrcycles(TICKUS) * n);
+}
+
+int sys_usleep(void) {
+	int n;
+
+	if (argint(0, &n) < 0 || n < 0)
+		return -1;
+	if (n == 0)
+		return myproc()->killed ? -1 : 0;
+	return hrsleep(hrcycles(n));
 }
 
-// return how many clock tick interrupts have occurred
-// since start.
-int sys_uptime(void) {
-	uint xticks;
+// return how many clock ticks have passed since start.
+int sys_uptime(void) { return tickupdate(); }
+
+// return microseconds since start, modulo 2^32.
+int sys_uptimeus(void) { return hrusec(hrtime()); }
 
-	acquire(&tickslock);
-	xticks = ticks;
-	release(&tickslock);
-	return xticks;
+// copy per-lock contention statistics to user space
+int sys_lockstat(void) {
+	struct lockstat *st;
+	int n;
+
+	if (argint(1, &n) < 0 || n < 0 ||
+	    argptr(0, (char **)&st, n * sizeof(*st)) < 0)
+		return -1;
+	return lockstats(st, n);
 }
 
 // System call untuk mematikan komputer (QEMU)
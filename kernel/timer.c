@@ -0,0 +1,199 @@
+// High-resolution timers.
+//
+// Time is kept in TSC cycles since boot, calibrated against the PIT by
+// lapiccalibrate(). Each CPU's local APIC timer runs in one-shot mode
+// and is programmed by timerarm() for the next thing that CPU has to
+// do: a scheduling tick while it runs a process, and the earliest
+// pending hrtimer. An idle CPU with no pending timers takes no timer
+// interrupts at all.
+
+#include "defs.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "param.h"
+#include "proc.h"
+#include "spinlock.h"
+#include "types.h"
+#include "x86.h"
+
+extern uint tscperus;
+
+static uint64 boottsc;
+static uint tickcyc; // TSC cycles per scheduling tick
+
+// Processes with a pending deadline, as a binary min-heap on wakeat.
+static struct {
+	struct spinlock lock;
+	int n;
+	struct proc *h[NPROC];
+} hrq;
+
+// 64-by-32 division; the kernel is not linked with libgcc.
+static uint64 div64(uint64 n, uint d) {
+	uint hi = n >> 32, lo = n, qhi, qlo, r;
+
+	qhi = hi / d;
+	r = hi % d;
+	asm volatile("divl %4" : "=a"(qlo), "=d"(r) : "a"(lo), "d"(r), "rm"(d));
+	return ((uint64)qhi << 32) | qlo;
+}
+
+void timerinit(void) {
+	initlock(&hrq.lock, "hrtimer");
+	boottsc = rdtsc();
+	tickcyc = tscperus * TICKUS;
+}
+
+// Cycles since boot.
+uint64 hrtime(void) { return rdtsc() - boottsc; }
+
+uint64 hrcycles(uint us) { return (uint64)us * tscperus; }
+
+uint hrusec(uint64 t) { return div64(t, tscperus); }
+
+static void hrswap(int i, int j) {
+	struct proc *p = hrq.h[i];
+
+	hrq.h[i] = hrq.h[j];
+	hrq.h[j] = p;
+}
+
+static void hrup(int i) {
+	while (i > 0 && hrq.h[(i - 1) / 2]->wakeat > hrq.h[i]->wakeat) {
+		hrswap(i, (i - 1) / 2);
+		i = (i - 1) / 2;
+	}
+}
+
+static void hrdown(int i) {
+	int c;
+
+	while ((c = 2 * i + 1) < hrq.n) {
+		if (c + 1 < hrq.n && hrq.h[c + 1]->wakeat < hrq.h[c]->wakeat)
+			c++;
+		if (hrq.h[i]->wakeat <= hrq.h[c]->wakeat)
+			break;
+		hrswap(i, c);
+		i = c;
+	}
+}
+
+static void hrremove(int i) {
+	hrq.h[i] = hrq.h[--hrq.n];
+	if (i < hrq.n) {
+		hrup(i);
+		hrdown(i);
+	}
+}
+
+static void hrdel(struct proc *p) {
+	int i;
+
+	for (i = 0; i < hrq.n; i++)
+		if (hrq.h[i] == p) {
+			hrremove(i);
+			return;
+		}
+}
+
+static void hradd(struct proc *p, uint64 when, void *chan) {
+	hrdel(p);
+	p->wakeat = when;
+	p->wakechan = chan;
+	hrq.h[hrq.n] = p;
+	hrup(hrq.n++);
+}
+
+// Arrange for p->wakechan to be woken at cycle time when. A null chan
+// marks a poll() timeout, which is delivered through pollwakeup().
+void hrarm(struct proc *p, uint64 when, void *chan) {
+	acquire(&hrq.lock);
+	hradd(p, when, chan);
+	release(&hrq.lock);
+	timerarm();
+}
+
+void hrcancel(struct proc *p) {
+	acquire(&hrq.lock);
+	hrdel(p);
+	release(&hrq.lock);
+}
+
+// Sleep for t cycles.
+int hrsleep(uint64 t) {
+	struct proc *p = myproc();
+
+	acquire(&hrq.lock);
+	hradd(p, hrtime() + t, &p->wakeat);
+	release(&hrq.lock);
+	timerarm();
+
+	acquire(&hrq.lock);
+	while (hrtime() < p->wakeat && !p->killed)
+		sleep(&p->wakeat, &hrq.lock);
+	hrdel(p);
+	release(&hrq.lock);
+	return p->killed ? -1 : 0;
+}
+
+static void hrexpire(void) {
+	uint64 now = hrtime();
+	struct proc *p;
+	int polled = 0;
+
+	acquire(&hrq.lock);
+	while (hrq.n > 0 && hrq.h[0]->wakeat <= now) {
+		p = hrq.h[0];
+		hrremove(0);
+		if (p->wakechan)
+			wakeup(p->wakechan);
+		else
+			polled = 1;
+	}
+	release(&hrq.lock);
+	if (polled)
+		pollwakeup();
+}
+
+// Bring ticks up to date. CPU 0 only counts ticks while it has
+// timer interrupts, so readers catch up from the clock.
+uint tickupdate(void) {
+	uint t;
+
+	acquire(&tickslock);
+	ticks = div64(hrtime(), tickcyc);
+	t = ticks;
+	release(&tickslock);
+	return t;
+}
+
+// Program this CPU's one-shot timer for its next event. The heap
+// head is read without hrq.lock: a stale value only costs a spurious
+// interrupt, and whoever adds an earlier deadline re-arms its own CPU.
+void timerarm(void) {
+	uint64 now, when = ~0ULL;
+	struct proc *p;
+
+	pushcli();
+	now = hrtime();
+	if (mycpu()->proc)
+		when = now + tickcyc;
+	if (hrq.n > 0 && (p = hrq.h[0]) != 0 && p->wakeat < when)
+		when = p->wakeat;
+	if (when == ~0ULL)
+		lapictimer(0);
+	else if (when <= now)
+		lapictimer(1);
+	else if (when - now > hrcycles(1000000))
+		lapictimer(1000000);
+	else
+		lapictimer(hrusec(when - now) + 1);
+	popcli();
+}
+
+void timerintr(void) {
+	if (cpuid() == 0)
+		tickupdate();
+	hrexpire();
+	timerarm();
+}
@@ -41,12 +41,10 @@ void trap(struct trapframe *tf) {
 
 	switch (tf->trapno) {
 	case T_IRQ0 + IRQ_TIMER:
-		if (cpuid() == 0) {
-			acquire(&tickslock);
-			ticks++;
-			wakeup(&ticks);
-			release(&tickslock);
-		}
+		timerintr();
+		lapiceoi();
+		break;
+	case T_IRQ0 + IRQ_WAKE:
 		lapiceoi();
 		break;
 	case T_IRQ0 + IRQ_IDE:
@@ -57,7 +55,7 @@ void trap(struct trapframe *tf) {
 		// Bochs generates spurious IDE1 interrupts.
 		break;
 	case T_IRQ0 + IRQ_MOUSE:
-		mouseintr(ticks);
+		mouseintr(tickupdate());
 		lapiceoi();
 		break;
 	case T_IRQ0 + IRQ_KBD:
@@ -75,6 +73,11 @@ void trap(struct trapframe *tf) {
 		lapiceoi();
 		break;
 
+	case T_PGFLT:
+		if (myproc() && (tf->cs & 3) == DPL_USER &&
+		    mmapfault(rcr2(), tf->err & 2) == 0)
+			break;
+		// fall through
 	// PAGEBREAK: 13
 	default:
 		if (myproc() == 0 || (tf->cs & 3) == 0) {
@@ -25,12 +25,31 @@ void seginit(void) {
 	c->gdt[SEG_UCODE] = SEG(STA_X | STA_R, 0, 0xffffffff, DPL_USER);
 	c->gdt[SEG_UDATA] = SEG(STA_W, 0, 0xffffffff, DPL_USER);
 	lgdt(c->gdt, sizeof(c->gdt));
+	patinit();
+}
+
+#define MSR_PAT 0x277
+
+static int havepat;
+
+// Reprogram PAT entry 1, which PTE_PWT alone selects, from
+// write-through to write-combining. Run on each CPU.
+void patinit(void) {
+	uint a, b, c, d;
+
+	cpuinfo(1, &a, &b, &c, &d);
+	if ((d & (1 << 16)) == 0)
+		return;
+	wbinvd();
+	wrmsr(MSR_PAT, 0x00070106, 0x00070106);
+	wbinvd();
+	havepat = 1;
 }
 
 // Return the address of the PTE in page table pgdir
 // that corresponds to virtual address va.  If alloc!=0,
 // create any required page table pages.
-static pte_t *walkpgdir(pde_t *pgdir, const void *va, int alloc) {
+pte_t *walkpgdir(pde_t *pgdir, const void *va, int alloc) {
 	pde_t *pde;
 	pte_t *pgtab;
 
@@ -53,7 +72,7 @@ static pte_t *walkpgdir(pde_t *pgdir, const void *va, int alloc) {
 // Create PTEs for virtual addresses starting at va that refer to
 // physical addresses starting at pa. va and size might not
 // be page-aligned.
-static int mappages(pde_t *pgdir, void *va, uint size, uint pa, int perm) {
+int mappages(pde_t *pgdir, void *va, uint size, uint pa, int perm) {
 	char *a, *last;
 	pte_t *pte;
 
@@ -108,6 +127,29 @@ static struct kmap {
 	{(void *)DEVSPACE, DEVSPACE, 0, PTE_W},		 // more devices
 };
 
+// Framebuffer pages to map write-combining; set by fbmapwc().
+static uint fbstart, fbend;
+
+static void setwc(pde_t *pgdir) {
+	pte_t *pte;
+	uint a;
+
+	for (a = fbstart; a < fbend; a += PGSIZE)
+		if ((pte = walkpgdir(pgdir, (void *)a, 0)) != 0)
+			*pte |= PTE_PWT;
+}
+
+// Map the framebuffer at [pa, pa+n) write-combining in the kernel
+// page table and in every page table made from now on.
+void fbmapwc(uint pa, uint n) {
+	if (!havepat || pa < DEVSPACE)
+		return;
+	fbstart = PGROUNDDOWN(pa);
+	fbend = PGROUNDUP(pa + n);
+	setwc(kpgdir);
+	switchkvm();
+}
+
 // Set up kernel part of a page table.
 pde_t *setupkvm(void) {
 	pde_t *pgdir;
@@ -124,6 +166,7 @@ pde_t *setupkvm(void) {
 			freevm(pgdir);
 			return 0;
 		}
+	setwc(pgdir);
 	return pgdir;
 }
 
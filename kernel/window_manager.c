@@ -4,6 +4,7 @@
 #include "mmu.h"
 #include "msg.h"
 #include "param.h"
+#include "poll.h"
 #include "proc.h"
 #include "spinlock.h"
 #include "types.h"
@@ -55,9 +56,59 @@ typedef struct {
 
 static mouse_pos_t wm_mouse_pos, wm_last_mouse_pos;
 
+// wmseq is odd while a writer holds wmlock and is changing draw
+// state. updateScreen copies that state out without the lock and
+// retries if wmseq moved, so input never waits behind a frame.
+static volatile uint wmseq;
+
+// Set while updateScreen draws from user memory. Closers wait for it
+// to clear so a window's address space outlives the frame using it.
+static volatile int composing;
+
+// What updateScreen needs to draw one window.
+struct wmview {
+	struct proc *proc;
+	win_rect position;
+	struct RGB *window_buf;
+	char title[MAX_TITLE_LEN];
+	int minimized;
+	int hasTitleBar;
+};
+
+// Snapshot of the draw state, desktop first and then bottom to top.
+// Only the desktop process composes, so one static copy suffices.
+static struct {
+	struct wmview win[MAX_WINDOW_CNT];
+	int n;
+	struct wmview popup;
+	int haspopup;
+	int mouseShape;
+	mouse_pos_t mouse;
+} frame;
+
 #define MOUSE_SPEED_X 1
 #define MOUSE_SPEED_Y -1
 
+static void wmwrite(void) {
+	acquire(&wmlock);
+	wmseq++;
+	__sync_synchronize();
+}
+
+static void wmwritedone(void) {
+	__sync_synchronize();
+	wmseq++;
+	release(&wmlock);
+}
+
+// Wait until no frame is drawing from a window that was just closed.
+static void wmwaitcompose(void) {
+	acquire(&wmlock);
+	while (composing)
+		sleep((void *)&composing, &wmlock);
+	release(&wmlock);
+}
+
 int isInRect(int xmin, int ymin, int xmax, int ymax, int x, int y) {
 	return (x >= xmin && x <= xmax && y >= ymin && y <= ymax);
 }
@@ -119,6 +170,7 @@ int dispatchMessage(msg_buf *buf, message *msg) {
 	buf->data[buf->rear] = *msg;
 	if ((++buf->rear) >= MSG_BUF_SIZE)
 		buf->rear = 0;
+	pollwakeup();
 	return 0;
 }
 
@@ -183,7 +235,7 @@ void wmInit() {
 
 	clickedOnTitle = clickedOnContent = clickedOnPopup = 0;
 
-	initlock(&wmlock, "wmlock");
+	initticketlock(&wmlock, "wmlock");
 }
 
 void debugPrintWindowList() {
@@ -294,7 +346,7 @@ void handleDesktopDockClick(int mouse_x, message *msg) {
 }
 
 void wmHandleMessage(message *msg) {
-	acquire(&wmlock);
+	wmwrite();
 
 	message newmsg;
 	switch (msg->msg_type) {
@@ -467,10 +519,10 @@ void wmHandleMessage(message *msg) {
 	default:
 		break;
 	}
-	release(&wmlock);
+	wmwritedone();
 }
 
-void drawWindowBar(struct RGB *dst, kernel_window *win, struct RGBA barcolor) {
+void drawWindowBar(struct RGB *dst, struct wmview *win, struct RGBA barcolor) {
 	int xmin = win->position.xmin;
 	int xmax = win->position.xmax + 1;
 	int ymin = win->position.ymin - TITLE_HEIGHT;
@@ -490,13 +542,11 @@ void drawWindowBar(struct RGB *dst, kernel_window *win, struct RGBA barcolor) {
 	drawIcon(dst, xmax - TITLE_HEIGHT - 1, ymin - 1, 0, iconColor);
 }
 
-void drawWindow(kernel_window *win) {
+// Draw the border and title bar, which come from the snapshot alone.
+static void drawWindowFrame(struct wmview *win) {
 	int width = win->position.xmax - win->position.xmin;
 	int height = win->position.ymax - win->position.ymin;
 
-	draw24ImagePart(screen_buf, win->window_buf, win->position.xmin,
-			win->position.ymin, width, height, 0, 0, width, height);
-
 	RGB borderColor;
 	borderColor.R = 60;
 	borderColor.G = 68;
@@ -509,6 +559,15 @@ void drawWindow(kernel_window *win) {
 	}
 }
 
+void drawWindow(struct wmview *win) {
+	int width = win->position.xmax - win->position.xmin;
+	int height = win->position.ymax - win->position.ymin;
+
+	draw24ImagePart(screen_buf, win->window_buf, win->position.xmin,
+			win->position.ymin, width, height, 0, 0, width, height);
+	drawWindowFrame(win);
+}
+
 // TAMBAH: Fungsi drawClock untuk menampilkan jam di dock
 void drawClock(struct RGB *dst) {
 	int hours, minutes, seconds;
@@ -533,8 +592,8 @@ void drawDesktopDock(struct RGB *dst) {
 	drawRectByCoord(dst, 0, SCREEN_HEIGHT - DOCK_HEIGHT, SCREEN_WIDTH,
 			SCREEN_HEIGHT, dockColor);
 
-	int p;
-	int windowCount = getWindowCount();
+	int i;
+	int windowCount = frame.n - 1;
 
 	struct RGBA startBtnColor;
 	startBtnColor.R = 66;
@@ -551,19 +610,16 @@ void drawDesktopDock(struct RGB *dst) {
 				    SHOW_DESKTOP_ICON_WIDTH - 90) /
 					   (windowCount + 1),
 				   DOCK_PROGRAM_NORMAL_WIDTH);
-		for (p = windowlisthead; p != -1; p = windowlist[p].next) {
-			if (p != desktopId) {
-				drawStringWithMaxWidth(
-					dst, xStart + 5,
-					SCREEN_HEIGHT - DOCK_HEIGHT * 0.7,
-					barWidth - 2, windowlist[p].wnd.title,
+		for (i = 1; i < frame.n; i++) {
+			drawStringWithMaxWidth(dst, xStart + 5,
+					       SCREEN_HEIGHT - DOCK_HEIGHT * 0.7,
+					       barWidth - 2, frame.win[i].title,
+					       txtColor);
+			drawRectByCoord(dst, xStart + barWidth - 2,
+					SCREEN_HEIGHT - DOCK_HEIGHT,
+					xStart + barWidth, SCREEN_HEIGHT,
 					txtColor);
-				drawRectByCoord(dst, xStart + barWidth - 2,
-						SCREEN_HEIGHT - DOCK_HEIGHT,
-						xStart + barWidth,
-						SCREEN_HEIGHT, txtColor);
-				xStart += barWidth;
-			}
+			xStart += barWidth;
 		}
 	}
 
@@ -577,48 +633,111 @@ void drawDesktopDock(struct RGB *dst) {
 		 SCREEN_HEIGHT - DOCK_HEIGHT + 3, 2, iconColor);
 }
 
-void updateScreen() {
-	acquire(&wmlock);
-	if (myproc() != windowlist[desktopId].proc) {
-		panic("Update screen called by non desktop process");
-		release(&wmlock);
-		return;
-	}
+static void copyview(struct wmview *v, struct proc *p, kernel_window *w) {
+	v->proc = p;
+	v->position = w->position;
+	v->window_buf = w->window_buf;
+	memmove(v->title, w->title, MAX_TITLE_LEN);
+	v->minimized = w->minimized;
+	v->hasTitleBar = w->hasTitleBar;
+}
 
-	memset(screen_buf, 255, screen_size);
-	drawWindow(&windowlist[desktopId].wnd);
-	drawDesktopDock(screen_buf);
+// Copy the draw state into frame. The list may be torn while a writer
+// runs, so the walk is bounded and the copy is retried.
+static void wmsnapshot(void) {
+	uint seq;
+	int i, p;
 
-	int p;
-	for (p = windowlisthead; p != -1; p = windowlist[p].next) {
-		if (p != desktopId && windowlist[p].wnd.minimized == 0) {
-			switchuvm(windowlist[p].proc);
-			drawWindow(&windowlist[p].wnd);
+	do {
+		while ((seq = wmseq) & 1)
+			pause();
+		__sync_synchronize();
+
+		frame.n = 0;
+		if (desktopId >= 0) {
+			copyview(&frame.win[0], windowlist[desktopId].proc,
+				 &windowlist[desktopId].wnd);
+			frame.n = 1;
+		}
+		p = windowlisthead;
+		for (i = 0; i < MAX_WINDOW_CNT && p >= 0 && p < MAX_WINDOW_CNT;
+		     i++) {
+			if (p != desktopId && frame.n > 0 &&
+			    frame.n < MAX_WINDOW_CNT)
+				copyview(&frame.win[frame.n++],
+					 windowlist[p].proc,
+					 &windowlist[p].wnd);
+			p = windowlist[p].next;
 		}
+		frame.haspopup = popupwindow.caller != -1;
+		if (frame.haspopup)
+			copyview(&frame.popup, popupwindow.proc,
+				 &popupwindow.wnd);
+		frame.mouseShape = mouseShape;
+		frame.mouse = wm_mouse_pos;
+
+		__sync_synchronize();
+	} while (wmseq != seq);
+}
+
+// Draw a window that lives in another process's address space. The
+// CPU must not be rescheduled while that page table is loaded, so the
+// buffer is copied FOREIGNROWS rows at a time with interrupts let in
+// between bands. The process can't go away meanwhile: closing a
+// window waits for composing to clear.
+#define FOREIGNROWS 32
+static void drawforeign(struct wmview *v) {
+	int width = v->position.xmax - v->position.xmin;
+	int height = v->position.ymax - v->position.ymin;
+	int y;
+
+	for (y = 0; y < height; y += FOREIGNROWS) {
+		pushcli();
+		switchuvm(v->proc);
+		draw24ImagePart(screen_buf, v->window_buf, v->position.xmin,
+				v->position.ymin + y, width, height, 0, y,
+				width, min(FOREIGNROWS, height - y));
+		switchuvm(myproc());
+		popcli();
 	}
+	drawWindowFrame(v);
+}
 
-	if (popupwindow.caller != -1) {
-		switchuvm(popupwindow.proc);
-		drawWindow(&popupwindow.wnd);
-	}
+void updateScreen() {
+	int i;
 
-	if (myproc() == 0)
-		switchkvm();
-	else
-		switchuvm(myproc());
+	composing = 1;
+	__sync_synchronize();
+	wmsnapshot();
+
+	if (frame.n == 0 || myproc()->leader != frame.win[0].proc)
+		panic("Update screen called by non desktop process");
 
-	drawMouse(screen_buf, mouseShape, wm_mouse_pos.x, wm_mouse_pos.y);
-	memmove(screen, screen_buf, screen_size);
+	memset(screen_buf, 255, screen_size);
+	drawWindow(&frame.win[0]);
+	drawDesktopDock(screen_buf);
 
+	for (i = 1; i < frame.n; i++)
+		if (frame.win[i].minimized == 0)
+			drawforeign(&frame.win[i]);
+	if (frame.haspopup)
+		drawforeign(&frame.popup);
+
+	acquire(&wmlock);
+	composing = 0;
+	wakeup((void *)&composing);
 	release(&wmlock);
+
+	drawMouse(screen_buf, frame.mouseShape, frame.mouse.x, frame.mouse.y);
+	fbflush();
 }
 
 int createWindow(window_p window, char *title) {
-	acquire(&wmlock);
+	wmwrite();
 
 	int winId = findNextAvailableWindowId();
 	if (winId == -1) {
-		release(&wmlock);
+		wmwritedone();
 		return 1;
 	}
 
@@ -652,7 +771,7 @@ int createWindow(window_p window, char *title) {
 
 	windowlist[winId].wnd.window_buf = window->window_buf;
 	window->handler = winId;
-	windowlist[winId].proc = myproc();
+	windowlist[winId].proc = myproc()->leader;
 	windowlist[winId].wnd.minimized = 0;
 	windowlist[winId].wnd.hasTitleBar = window->hasTitleBar;
 
@@ -665,16 +784,16 @@ int createWindow(window_p window, char *title) {
 	memset(windowlist[winId].wnd.title, 0, MAX_TITLE_LEN);
 	memmove(windowlist[winId].wnd.title, title, len);
 
-	release(&wmlock);
+	wmwritedone();
 
 	return 0;
 }
 
 int createPopupWindow(window_p window, int caller) {
-	acquire(&wmlock);
+	wmwrite();
 
 	if (popupwindow.caller != -1) {
-		release(&wmlock);
+		wmwritedone();
 		return 1;
 	}
 
@@ -693,30 +812,31 @@ int createPopupWindow(window_p window, int caller) {
 	popupwindow.wnd.window_buf = window->window_buf;
 	popupwindow.caller = caller;
 	window->handler = caller;
-	popupwindow.proc = myproc();
+	popupwindow.proc = myproc()->leader;
 	popupwindow.wnd.minimized = 0;
 	popupwindow.wnd.hasTitleBar = window->hasTitleBar;
 	initMessageQueue(&popupwindow.wnd.msg_buf);
 
-	release(&wmlock);
+	wmwritedone();
 	return 0;
 }
 
 int closePopupWindow(window_p window) {
-	acquire(&wmlock);
+	wmwrite();
 
 	popupwindow.caller = -1;
 	initMessageQueue(&popupwindow.wnd.msg_buf);
 	window->handler = -1;
 	memset(popupwindow.wnd.title, 0, MAX_TITLE_LEN);
 
-	release(&wmlock);
+	wmwritedone();
+	wmwaitcompose();
 
 	return 0;
 }
 
 int closeWindow(window_p window) {
-	acquire(&wmlock);
+	wmwrite();
 
 	int winId = window->handler;
 	removeFromWindowList(winId);
@@ -732,13 +852,14 @@ int closeWindow(window_p window) {
 
 	window->handler = -1;
 
-	release(&wmlock);
+	wmwritedone();
+	wmwaitcompose();
 
 	return 0;
 }
 
 int minimizeWindow(window_p window) {
-	acquire(&wmlock);
+	wmwrite();
 
 	int winId = window->handler;
 
@@ -747,20 +868,20 @@ int minimizeWindow(window_p window) {
 		focusWindow(windowlist[winId].prev);
 	}
 
-	release(&wmlock);
+	wmwritedone();
 
 	return 0;
 }
 
 int maximizeWindow(window_p window) {
-	acquire(&wmlock);
+	wmwrite();
 
 	int winId = window->handler;
 
 	windowlist[winId].wnd.minimized = 0;
 	focusWindow(winId);
 
-	release(&wmlock);
+	wmwritedone();
 
 	return 0;
 }
@@ -773,11 +894,11 @@ int turnoffScreen() {
 		newmsg.msg_type = WM_WINDOW_CLOSE;
 		dispatchMessage(&windowlist[p].wnd.msg_buf, &newmsg);
 	}
-	memset(screen_buf, 255, screen_size);
-	memmove(screen, screen_buf, screen_size);
-
 	release(&wmlock);
 
+	memset(screen_buf, 255, screen_size);
+	fbflush();
+
 	return 0;
 }
 
@@ -826,12 +947,21 @@ int sys_GUI_getMessage() {
 	message *res;
 	argint(0, &h);
 	argptr(1, (char **)(&res), sizeof(message));
-	if (myproc() != windowlist[h].proc) {
+	if (myproc()->leader != windowlist[h].proc) {
 		return 1;
 	}
 	return getMessage(&windowlist[h].wnd.msg_buf, res);
 }
 
+// Readiness of window handle h for poll(): POLLIN once a message is
+// queued for it. Any thread of the owning process may poll it.
+int wmpoll(int h) {
+	if (h < 0 || h >= MAX_WINDOW_CNT ||
+	    windowlist[h].proc != myproc()->leader)
+		return POLLNVAL;
+	return windowlist[h].wnd.msg_buf.cnt > 0 ? POLLIN : 0;
+}
+
 int sys_GUI_getPopupMessage() {
 	message *res;
 	argptr(0, (char **)(&res), sizeof(message));
@@ -0,0 +1,28 @@
+#include "lockstat.h"
+#include "types.h"
+#include "user.h"
+
+#define NSTAT 64
+
+struct lockstat st[NSTAT];
+
+// Print contention statistics for every kernel spinlock class that has
+// been used. Hold times are in TSC cycles.
+int main(int argc, char *argv[]) {
+	int i, n;
+
+	if ((n = lockstat(st, NSTAT)) < 0) {
+		printf(2, "lockstat: kernel built without LOCKSTAT=1\n");
+		exit();
+	}
+
+	for (i = 0; i < n; i++) {
+		if (st[i].nacquire == 0)
+			continue;
+		printf(1, "%s: acquire %d contend %d spins %d\n", st[i].name,
+		       st[i].nacquire, st[i].ncontend, st[i].nspin);
+		printf(1, "    hold max %d total %dk\n", st[i].hold_max,
+		       st[i].hold_kcycles);
+	}
+	exit();
+}
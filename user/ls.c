@@ -1,3 +1,4 @@
+#include "fcntl.h"
 #include "fs.h"
 #include "stat.h"
 #include "types.h"
@@ -21,9 +22,9 @@ char *fmtname(char *path) {
 }
 
 void ls(char *path) {
-	char buf[512], *p;
-	int fd;
-	struct dirent de;
+	char name[DIRSIZ + 1];
+	int fd, i, n;
+	struct dirstat ds[64];
 	struct stat st;
 
 	if ((fd = open(path, 0)) < 0) {
@@ -44,24 +45,14 @@ void ls(char *path) {
 		break;
 
 	case T_DIR:
-		if (strlen(path) + 1 + DIRSIZ + 1 > sizeof buf) {
-			printf(1, "ls: path too long\n");
-			break;
-		}
-		strcpy(buf, path);
-		p = buf + strlen(buf);
-		*p++ = '/';
-		while (read(fd, &de, sizeof(de)) == sizeof(de)) {
-			if (de.inum == 0)
-				continue;
-			memmove(p, de.name, DIRSIZ);
-			p[DIRSIZ] = 0;
-			if (stat(buf, &st) < 0) {
-				printf(1, "ls: cannot stat %s\n", buf);
-				continue;
+		// entries come with their type and size, a batch per call
+		name[DIRSIZ] = 0;
+		while ((n = getdents(fd, ds, sizeof(ds), DENT_STAT)) > 0) {
+			for (i = 0; i < n / sizeof(ds[0]); i++) {
+				memmove(name, ds[i].name, DIRSIZ);
+				printf(1, "%s %d %d %d\n", fmtname(name),
+				       ds[i].type, ds[i].inum, ds[i].size);
 			}
-			printf(1, "%s %d %d %d\n", fmtname(buf), st.type,
-			       st.ino, st.size);
 		}
 		break;
 	}
@@ -0,0 +1,90 @@
+#include "types.h"
+#include "user.h"
+#include "umalloc.h"
+
+#define BUFSZ (1 << 20)
+#define TOTAL (32 << 20) // bytes moved per measurement
+
+static char *src, *dst;
+
+static void bytecopy(char *d, const char *s, int n) {
+	while (n-- > 0)
+		*d++ = *s++;
+}
+
+// Return MB/s (bytes per microsecond) for TOTAL bytes in size-byte
+// calls. kind 0 is memmove, 1 is memset, 2 is a byte loop.
+static int rate(int kind, int size, int skew) {
+	uint t0, us;
+	int i, reps = TOTAL / size;
+
+	t0 = uptimeus();
+	for (i = 0; i < reps; i++) {
+		if (kind == 0)
+			memmove(dst + skew, src, size);
+		else if (kind == 1)
+			memset(dst + skew, i, size);
+		else
+			bytecopy(dst + skew, src, size);
+	}
+	us = uptimeus() - t0;
+	return us ? TOTAL / us : 0;
+}
+
+// Return nanoseconds per malloc()/free() pair, with NLIVE objects
+// of up to size bytes kept alive so the heap is not trivially empty;
+// fewer for large sizes, to keep about LIVEBYTES live.
+#define NLIVE 256
+#define LIVEBYTES (4 << 20)
+static int heaprate(int size) {
+	static char *live[NLIVE];
+	uint t0, us, seed = 1;
+	int i, reps = 100000;
+	int nlive = LIVEBYTES / size < NLIVE ? LIVEBYTES / size : NLIVE;
+
+	t0 = uptimeus();
+	for (i = 0; i < reps; i++) {
+		seed = seed * 1103515245 + 12345;
+		free(live[i % nlive]);
+		live[i % nlive] = malloc(1 + (seed >> 16) % size);
+	}
+	us = uptimeus() - t0;
+	for (i = 0; i < NLIVE; i++) {
+		free(live[i]);
+		live[i] = 0;
+	}
+	return us / (reps / 1000);
+}
+
+// Measure the memmove and memset in ULIB against a byte loop, with
+// an aligned and a misaligned destination, then the cost of malloc().
+int main(int argc, char *argv[]) {
+	static int sizes[] = {64, 4096, 65536, BUFSZ};
+	static int heapsizes[] = {64, 2048, 16384, 262144};
+	struct heapstat hs;
+	int i, size;
+
+	src = malloc(BUFSZ + 4);
+	dst = malloc(BUFSZ + 4);
+	if (src == 0 || dst == 0) {
+		printf(2, "membench: out of memory\n");
+		exit();
+	}
+	memset(src, 'x', BUFSZ);
+
+	printf(1, "size     memmove  +1      memset  +1      bytes   (MB/s)\n");
+	for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		size = sizes[i];
+		printf(1, "%d\t %d\t  %d\t  %d\t  %d\t  %d\n", size,
+		       rate(0, size, 0), rate(0, size, 1), rate(1, size, 0),
+		       rate(1, size, 1), rate(2, size, 0));
+	}
+
+	printf(1, "malloc   ns/pair\n");
+	for (i = 0; i < sizeof(heapsizes) / sizeof(heapsizes[0]); i++)
+		printf(1, "%d\t %d\n", heapsizes[i], heaprate(heapsizes[i]));
+	heapstat(&hs);
+	printf(1, "heap %d: slabs %d (small %d), large %d, free %d\n",
+	       hs.heap, hs.slabs, hs.small, hs.large, hs.free);
+	exit();
+}
@@ -347,10 +347,7 @@ void inputHandler(Widget *w, message *msg) {
 			// Grow input field height as needed
 			int newHeight =
 				CHARACTER_HEIGHT *
-				(getMouseYFromOffset(
-					 w->context.inputfield->text, width,
-					 strlen(w->context.inputfield->text)) +
-				 1);
+				inputFieldRows(w->context.inputfield, width);
 			if (newHeight > height) {
 				w->position.ymax = w->position.ymin + newHeight;
 			}
@@ -0,0 +1,193 @@
+#include "types.h"
+#include "user.h"
+#include "textbuf.h"
+
+#define TBMIN 256
+
+int tbinit(struct textbuf *tb) {
+	tb->cap = TBMIN;
+	tb->gap = 0;
+	tb->gapend = TBMIN;
+	tb->lcap = TBMIN / 8;
+	tb->lgap = 1;
+	tb->lgapend = tb->lcap;
+	tb->text = malloc(tb->cap);
+	tb->line = malloc(tb->lcap * sizeof(int));
+	if (tb->text == 0 || tb->line == 0) {
+		tbfree(tb);
+		return -1;
+	}
+	tb->line[0] = 0;
+	return 0;
+}
+
+void tbfree(struct textbuf *tb) {
+	free(tb->text);
+	free(tb->line);
+	tb->text = 0;
+	tb->line = 0;
+}
+
+int tblen(struct textbuf *tb) { return tb->cap - (tb->gapend - tb->gap); }
+
+int tbnlines(struct textbuf *tb) { return tb->lgap + tb->lcap - tb->lgapend; }
+
+int tbchar(struct textbuf *tb, int off) {
+	if (off < 0 || off >= tblen(tb))
+		return 0;
+	if (off >= tb->gap)
+		off += tb->gapend - tb->gap;
+	return tb->text[off];
+}
+
+// Offset of the first character of line n.
+int tblinestart(struct textbuf *tb, int n) {
+	if (n <= 0)
+		return 0;
+	if (n >= tbnlines(tb))
+		return tblen(tb);
+	if (n < tb->lgap)
+		return tb->line[n];
+	return tblen(tb) - tb->line[n - tb->lgap + tb->lgapend];
+}
+
+// Length of line n, not counting its newline.
+int tblinelen(struct textbuf *tb, int n) {
+	int end;
+
+	if (n + 1 < tbnlines(tb))
+		end = tblinestart(tb, n + 1) - 1;
+	else
+		end = tblen(tb);
+	return end - tblinestart(tb, n);
+}
+
+// Line containing offset off, by binary search of the index.
+int tblineof(struct textbuf *tb, int off) {
+	int lo = 0, hi = tbnlines(tb) - 1, mid;
+
+	while (lo < hi) {
+		mid = (lo + hi + 1) / 2;
+		if (tblinestart(tb, mid) <= off)
+			lo = mid;
+		else
+			hi = mid - 1;
+	}
+	return lo;
+}
+
+// Move the gap so that it starts at offset off.
+static void tbmove(struct textbuf *tb, int off) {
+	int len = tblen(tb), n;
+
+	if (off < tb->gap) {
+		n = tb->gap - off;
+		memmove(tb->text + tb->gapend - n, tb->text + off, n);
+		tb->gap -= n;
+		tb->gapend -= n;
+		while (tb->lgap > 1 && tb->line[tb->lgap - 1] > off)
+			tb->line[--tb->lgapend] = len - tb->line[--tb->lgap];
+	} else if (off > tb->gap) {
+		n = off - tb->gap;
+		memmove(tb->text + tb->gap, tb->text + tb->gapend, n);
+		tb->gap += n;
+		tb->gapend += n;
+		while (tb->lgapend < tb->lcap &&
+		       len - tb->line[tb->lgapend] <= off)
+			tb->line[tb->lgap++] = len - tb->line[tb->lgapend++];
+	}
+}
+
+// Make room for at least n more characters and one more line.
+static int tbgrow(struct textbuf *tb, int n) {
+	int cap, tail;
+	char *text;
+	int *line;
+
+	if (tb->gapend - tb->gap < n) {
+		cap = tb->cap * 2;
+		while (cap - tblen(tb) < n)
+			cap *= 2;
+		if ((text = malloc(cap)) == 0)
+			return -1;
+		tail = tb->cap - tb->gapend;
+		memmove(text, tb->text, tb->gap);
+		memmove(text + cap - tail, tb->text + tb->gapend, tail);
+		free(tb->text);
+		tb->text = text;
+		tb->gapend = cap - tail;
+		tb->cap = cap;
+	}
+	if (tb->lgap == tb->lgapend) {
+		cap = tb->lcap * 2;
+		if ((line = malloc(cap * sizeof(int))) == 0)
+			return -1;
+		tail = tb->lcap - tb->lgapend;
+		memmove(line, tb->line, tb->lgap * sizeof(int));
+		memmove(line + cap - tail, tb->line + tb->lgapend,
+			tail * sizeof(int));
+		free(tb->line);
+		tb->line = line;
+		tb->lgapend = cap - tail;
+		tb->lcap = cap;
+	}
+	return 0;
+}
+
+// Insert n bytes of s at offset off.
+int tbinsert(struct textbuf *tb, int off, char *s, int n) {
+	int i;
+
+	if (off < 0 || off > tblen(tb) || tbgrow(tb, n) < 0)
+		return -1;
+	tbmove(tb, off);
+	for (i = 0; i < n; i++) {
+		tb->text[tb->gap++] = s[i];
+		if (s[i] == '\n') {
+			if (tbgrow(tb, 0) < 0)
+				return -1;
+			tb->line[tb->lgap++] = tb->gap;
+		}
+	}
+	return 0;
+}
+
+// Delete the character at offset off.
+int tbdelete(struct textbuf *tb, int off) {
+	if (off < 0 || off >= tblen(tb))
+		return -1;
+	tbmove(tb, off);
+	if (tb->text[tb->gapend] == '\n')
+		tb->lgapend++;
+	tb->gapend++;
+	return 0;
+}
+
+// Replace the contents with everything readable from fd.
+int tbread(struct textbuf *tb, int fd) {
+	char buf[512];
+	int n;
+
+	tbclear(tb);
+	while ((n = read(fd, buf, sizeof(buf))) > 0)
+		if (tbinsert(tb, tblen(tb), buf, n) < 0)
+			return -1;
+	return n < 0 ? -1 : tblen(tb);
+}
+
+// Write the whole text to fd.
+int tbwrite(struct textbuf *tb, int fd) {
+	int tail = tb->cap - tb->gapend;
+
+	if (write(fd, tb->text, tb->gap) != tb->gap ||
+	    write(fd, tb->text + tb->gapend, tail) != tail)
+		return -1;
+	return tblen(tb);
+}
+
+void tbclear(struct textbuf *tb) {
+	tb->gap = 0;
+	tb->gapend = tb->cap;
+	tb->lgap = 1;
+	tb->lgapend = tb->lcap;
+}
@@ -0,0 +1,46 @@
+#include "types.h"
+#include "user.h"
+
+// Threads run on a malloc'd stack whose first two words hold the
+// function and argument, so threadstart needs nothing but the stack.
+// There is no guard page below it: a thread that overruns TSTACK
+// writes over the heap.
+
+#define TSTACK 16384
+
+struct tstart {
+	void (*fn)(void *);
+	void *arg;
+};
+
+static void threadstart(void *stack) {
+	struct tstart *ts = stack;
+
+	ts->fn(ts->arg);
+	exit();
+}
+
+// Start fn(arg) in a new thread; return its pid or -1.
+int thread_create(void (*fn)(void *), void *arg) {
+	struct tstart *ts;
+	int pid;
+
+	if ((ts = malloc(TSTACK)) == 0)
+		return -1;
+	ts->fn = fn;
+	ts->arg = arg;
+	if ((pid = clone(threadstart, ts, ts + 1, TSTACK - sizeof(*ts))) < 0)
+		free(ts);
+	return pid;
+}
+
+// Wait for a thread to exit, free its stack and return its pid.
+int thread_join(void) {
+	void *stack;
+	int pid;
+
+	if ((pid = join(&stack)) < 0)
+		return -1;
+	free((struct tstart *)stack - 1);
+	return pid;
+}
@@ -0,0 +1,82 @@
+#include "fcntl.h"
+#include "types.h"
+#include "ulock.h"
+#include "user.h"
+
+#define NTHREAD 4
+#define NINC 10000
+
+static struct mutex lock;
+static struct sem started;
+static struct sem done;
+static int counter;
+static int sharedfd = -1;
+
+static void adder(void *arg) {
+	char buf[8192]; // deeper than the old 4KB thread stacks
+
+	memset(buf, (int)arg, sizeof(buf));
+	for (int i = 0; i < NINC; i++) {
+		mutex_lock(&lock);
+		counter++;
+		mutex_unlock(&lock);
+	}
+}
+
+static void opener(void *arg) {
+	sharedfd = open("threadtest.tmp", O_CREATE | O_RDWR);
+}
+
+static void waiter(void *arg) {
+	sem_post(&started);
+	sem_wait(&done);
+}
+
+static void fail(char *what) {
+	printf(2, "threadtest: %s failed\n", what);
+	exit();
+}
+
+// Exercise clone() and join() through thread_create(): a counter
+// bumped under a mutex, a descriptor opened by one thread and used by
+// another, and sbrk() refusing to shrink memory other threads run in.
+int main(int argc, char *argv[]) {
+	int i;
+
+	mutex_init(&lock);
+	for (i = 0; i < NTHREAD; i++)
+		if (thread_create(adder, (void *)i) < 0)
+			fail("thread_create");
+	for (i = 0; i < NTHREAD; i++)
+		if (thread_join() < 0)
+			fail("thread_join");
+	if (thread_join() >= 0)
+		fail("join with no threads");
+	if (counter != NTHREAD * NINC)
+		fail("mutex");
+
+	if (thread_create(opener, 0) < 0 || thread_join() < 0)
+		fail("thread_create");
+	if (sharedfd < 0 || write(sharedfd, "x", 1) != 1)
+		fail("shared descriptor");
+	close(sharedfd);
+	unlink("threadtest.tmp");
+
+	sem_init(&started, 0);
+	sem_init(&done, 0);
+	if (sbrk(4096) == (char *)-1)
+		fail("sbrk");
+	if (thread_create(waiter, 0) < 0)
+		fail("thread_create");
+	sem_wait(&started);
+	if (sbrk(-4096) != (char *)-1)
+		fail("shrink refused");
+	sem_post(&done);
+	if (thread_join() < 0)
+		fail("thread_join");
+	if (sbrk(-4096) == (char *)-1)
+		fail("shrink");
+
+	printf(1, "threadtest: ok\n");
+	exit();
+}
@@ -27,11 +27,6 @@ uint strlen(const char *s) {
 	return n;
 }
 
-void *memset(void *dst, int c, uint n) {
-	stosb(dst, c, n);
-	return dst;
-}
-
 char *strchr(const char *s, char c) {
 	for (; *s; s++)
 		if (*s == c)
@@ -76,17 +71,6 @@ int atoi(const char *s) {
 	return n;
 }
 
-void *memmove(void *vdst, const void *vsrc, int n) {
-	char *dst;
-	const char *src;
-
-	dst = vdst;
-	src = vsrc;
-	while (n-- > 0)
-		*dst++ = *src++;
-	return vdst;
-}
-
 char *strcat(char *dest, const char *src) {
 	char *ret = dest;
 	while (*dest)
@@ -0,0 +1,102 @@
+#include "types.h"
+#include "user.h"
+#include "ulock.h"
+#include "x86.h"
+
+#define WAKEALL 0x7fffffff
+
+static void atomicadd(volatile uint *a, int n) {
+	uint v;
+
+	do
+		v = *a;
+	while (cmpxchg(a, v, v + n) != v);
+}
+
+void mutex_init(struct mutex *m) { m->state = 0; }
+
+void mutex_lock(struct mutex *m) {
+	uint c;
+
+	if ((c = cmpxchg(&m->state, 0, 1)) == 0)
+		return;
+	// Mark the mutex contended so its holder wakes us on unlock.
+	if (c != 2)
+		c = xchg(&m->state, 2);
+	while (c != 0) {
+		futexwait(&m->state, 2);
+		c = xchg(&m->state, 2);
+	}
+}
+
+// Return 0 if the mutex was taken, -1 if it is held.
+int mutex_trylock(struct mutex *m) {
+	return cmpxchg(&m->state, 0, 1) == 0 ? 0 : -1;
+}
+
+void mutex_unlock(struct mutex *m) {
+	if (xchg(&m->state, 0) == 2)
+		futexwake(&m->state, 1);
+}
+
+void cond_init(struct cond *c) {
+	c->seq = 0;
+	c->waiters = 0;
+}
+
+// Release m, wait for a signal, and take m again. As usual the
+// caller must recheck its condition: wakeups may be spurious.
+void cond_wait(struct cond *c, struct mutex *m) {
+	uint seq = c->seq;
+
+	atomicadd(&c->waiters, 1);
+	mutex_unlock(m);
+	futexwait(&c->seq, seq);
+	// Others may have been woken with us; take m as contended.
+	while (xchg(&m->state, 2) != 0)
+		futexwait(&m->state, 2);
+	atomicadd(&c->waiters, -1);
+}
+
+void cond_signal(struct cond *c) {
+	if (c->waiters == 0)
+		return;
+	atomicadd(&c->seq, 1);
+	futexwake(&c->seq, 1);
+}
+
+void cond_broadcast(struct cond *c) {
+	if (c->waiters == 0)
+		return;
+	atomicadd(&c->seq, 1);
+	futexwake(&c->seq, WAKEALL);
+}
+
+void sem_init(struct sem *s, int n) {
+	s->count = n;
+	s->waiters = 0;
+}
+
+// Return 0 if the count was taken, -1 if it was zero.
+int sem_trywait(struct sem *s) {
+	uint v;
+
+	while ((v = s->count) > 0)
+		if (cmpxchg(&s->count, v, v - 1) == v)
+			return 0;
+	return -1;
+}
+
+void sem_wait(struct sem *s) {
+	while (sem_trywait(s) < 0) {
+		atomicadd(&s->waiters, 1);
+		futexwait(&s->count, 0);
+		atomicadd(&s->waiters, -1);
+	}
+}
+
+void sem_post(struct sem *s) {
+	atomicadd(&s->count, 1);
+	if (s->waiters)
+		futexwake(&s->count, 1);
+}
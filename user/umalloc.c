@@ -1,84 +1,292 @@
+#include "memlayout.h"
+#include "mmu.h"
 #include "param.h"
 #include "stat.h"
 #include "types.h"
 #include "user.h"
+#include "ulock.h"
+#include "umalloc.h"
 
-// Memory allocator by Kernighan and Ritchie,
-// The C programming Language, 2nd ed.  Section 8.7.
+// Size-class slab allocator.
+//
+// The heap is carved into PGSIZE pages, each starting with a struct
+// page, so free() finds an object's page by rounding its address
+// down. A small request is rounded up to one of NCLASS sizes and
+// served from a slab: a page cut into objects of that size, whose
+// free ones are linked through their first word. Each class keeps
+// a list of its slabs that still have room, so small malloc() and
+// free() are O(1). A large request takes a run of whole pages, and
+// the object starts just past the run's header.
+//
+// Free pages are kept in a list of runs sorted by address, and
+// neighbouring runs are merged. A slab that empties goes back to
+// it unless it is its class's last one, and a free run at the
+// top of the heap goes back to the kernel once it is big enough.
+//
+// Each class has its own mutex and the page list has another, so
+// threads allocating different sizes don't contend.
 
-typedef long Align;
+#define HDRSIZE 32      // bytes of struct page, rounded to 16
+#define GROWPAGES 8     // fewest pages to sbrk() at a time
+#define TRIMPAGES 16    // free pages at the top worth giving back
+#define LARGE 0xfffe    // page.kind of a large object
+#define FREE 0xffff     // page.kind of a free run
 
-union header {
-	struct {
-		union header *ptr;
-		uint size;
-	} s;
-	Align x;
+struct page {
+	uint kind;                // size class, LARGE or FREE
+	uint npages;              // pages in a large object or free run
+	uint nfree;               // free objects in a slab
+	char *free;               // free objects in a slab
+	struct page *next, *prev; // partial slabs of a class; free runs
 };
 
-typedef union header Header;
+static ushort classsize[] = {16,  32,  48,  64,  80,  96,   112,
+			     128, 160, 192, 224, 256, 320,  384,
+			     448, 512, 640, 768, 1008, 1344, 2032};
 
-static Header base;
-static Header *freep;
+#define NCLASS (sizeof(classsize) / sizeof(classsize[0]))
+#define MAXSMALL 2032
 
-void free(void *ap) {
-	Header *bp, *p;
-
-	bp = (Header *)ap - 1;
-	for (p = freep; !(bp > p && bp < p->s.ptr); p = p->s.ptr)
-		if (p >= p->s.ptr && (bp > p || bp < p->s.ptr))
-			break;
-	if (bp + bp->s.size == p->s.ptr) {
-		bp->s.size += p->s.ptr->s.size;
-		bp->s.ptr = p->s.ptr->s.ptr;
-	} else
-		bp->s.ptr = p->s.ptr;
-	if (p + p->s.size == bp) {
-		p->s.size += bp->s.size;
-		p->s.ptr = bp->s.ptr;
-	} else
-		p->s.ptr = bp;
-	freep = p;
-}
+static struct {
+	struct mutex lock;
+	struct page *partial; // slabs with free objects
+	uint nslabs;
+	uint inuse; // objects handed out
+} class[NCLASS];
 
-static Header *morecore(uint nu) {
-	char *p;
-	Header *hp;
+static struct {
+	struct mutex lock;
+	struct page *free; // free runs, by address
+	char *end;         // break after our last sbrk()
+	uint heap;         // bytes taken from sbrk()
+	uint large;        // pages in large objects
+	uint free_pages;
+} pool;
 
-	if (nu < 4096)
-		nu = 4096;
-	p = sbrk(nu * sizeof(Header));
-	if (p == (char *)-1)
-		return 0;
-	hp = (Header *)p;
-	hp->s.size = nu;
-	free((void *)(hp + 1));
-	return freep;
+// Put npages pages at p on the free list, merging neighbours, and
+// give the top of the heap back if it has grown large.
+// pool.lock must be held.
+static void pagefree(struct page *p, uint npages) {
+	struct page *q, *prev = 0;
+	uint n;
+
+	for (q = pool.free; q && q < p; q = q->next)
+		prev = q;
+	p->kind = FREE;
+	p->npages = npages;
+	p->next = q;
+	if (q && (char *)p + npages * PGSIZE == (char *)q) {
+		p->npages += q->npages;
+		p->next = q->next;
+	}
+	if (prev && (char *)prev + prev->npages * PGSIZE == (char *)p) {
+		prev->npages += p->npages;
+		prev->next = p->next;
+		p = prev;
+	} else if (prev)
+		prev->next = p;
+	else
+		pool.free = p;
+	pool.free_pages += npages;
+
+	if (p->next || p->npages < TRIMPAGES ||
+	    (char *)p + p->npages * PGSIZE != pool.end || sbrk(0) != pool.end)
+		return;
+	n = p->npages;
+	if (sbrk(-(int)(n * PGSIZE)) == (char *)-1)
+		return;
+	for (q = pool.free, prev = 0; q != p; q = q->next)
+		prev = q;
+	if (prev)
+		prev->next = 0;
+	else
+		pool.free = 0;
+	pool.end -= n * PGSIZE;
+	pool.heap -= n * PGSIZE;
+	pool.free_pages -= n;
 }
 
-void *malloc(uint nbytes) {
-	Header *p, *prevp;
-	uint nunits;
+// Take npages pages from the first run that fits, growing the heap
+// if none does. pool.lock must be held.
+static struct page *pagealloc(uint npages) {
+	struct page *p, **pp;
+	char *brk, *a;
+	uint n, pad;
 
-	nunits = (nbytes + sizeof(Header) - 1) / sizeof(Header) + 1;
-	if ((prevp = freep) == 0) {
-		base.s.ptr = freep = prevp = &base;
-		base.s.size = 0;
-	}
-	for (p = prevp->s.ptr;; prevp = p, p = p->s.ptr) {
-		if (p->s.size >= nunits) {
-			if (p->s.size == nunits)
-				prevp->s.ptr = p->s.ptr;
+	for (;;) {
+		for (pp = &pool.free; (p = *pp) != 0; pp = &p->next) {
+			if (p->npages < npages)
+				continue;
+			if (p->npages == npages)
+				*pp = p->next;
 			else {
-				p->s.size -= nunits;
-				p += p->s.size;
-				p->s.size = nunits;
+				*pp = (struct page *)((char *)p + npages * PGSIZE);
+				(*pp)->kind = FREE;
+				(*pp)->npages = p->npages - npages;
+				(*pp)->next = p->next;
 			}
-			freep = prevp;
-			return (void *)(p + 1);
+			pool.free_pages -= npages;
+			return p;
 		}
-		if (p == freep)
-			if ((p = morecore(nunits)) == 0)
+
+		// Keep pages aligned even if someone else moved the break.
+		n = npages < GROWPAGES ? GROWPAGES : npages;
+		brk = sbrk(0);
+		pad = -(uint)brk & (PGSIZE - 1);
+		if ((a = sbrk(pad + n * PGSIZE)) == (char *)-1)
+			return 0;
+		if (a != brk) {
+			// lost a race with a bare sbrk(); use what lines up
+			pad = -(uint)a & (PGSIZE - 1);
+			if (n-- == 1)
 				return 0;
+		}
+		pool.end = a + pad + n * PGSIZE;
+		pool.heap += n * PGSIZE;
+		p = (struct page *)(a + pad);
+		if (n < npages) {
+			pagefree(p, n);
+			continue;
+		}
+		// Take the pages from the new run itself: freed whole, a
+		// run this big at the top would be given right back.
+		if (n > npages)
+			pagefree((struct page *)((char *)p + npages * PGSIZE),
+				 n - npages);
+		return p;
+	}
+}
+
+// Make a slab for class c. class[c].lock must be held.
+static struct page *newslab(int c) {
+	struct page *s;
+	char *o;
+	uint i, n;
+
+	mutex_lock(&pool.lock);
+	s = pagealloc(1);
+	mutex_unlock(&pool.lock);
+	if (s == 0)
+		return 0;
+	n = (PGSIZE - HDRSIZE) / classsize[c];
+	s->kind = c;
+	s->nfree = n;
+	s->free = 0;
+	o = (char *)s + HDRSIZE + (n - 1) * classsize[c];
+	for (i = 0; i < n; i++, o -= classsize[c]) {
+		*(char **)o = s->free;
+		s->free = o;
+	}
+	s->prev = 0;
+	s->next = class[c].partial;
+	if (s->next)
+		s->next->prev = s;
+	class[c].partial = s;
+	class[c].nslabs++;
+	return s;
+}
+
+static void *largealloc(uint nbytes) {
+	struct page *p;
+	uint n = (nbytes + HDRSIZE + PGSIZE - 1) / PGSIZE;
+
+	if (nbytes > MMAPBASE)
+		return 0;
+	mutex_lock(&pool.lock);
+	if ((p = pagealloc(n)) != 0) {
+		p->kind = LARGE;
+		p->npages = n;
+		pool.large += n;
+	}
+	mutex_unlock(&pool.lock);
+	return p ? (char *)p + HDRSIZE : 0;
+}
+
+void *malloc(uint nbytes) {
+	struct page *s;
+	char *o;
+	int c;
+
+	if (nbytes > MAXSMALL)
+		return largealloc(nbytes);
+	for (c = 0; classsize[c] < nbytes; c++)
+		;
+
+	mutex_lock(&class[c].lock);
+	if ((s = class[c].partial) == 0 && (s = newslab(c)) == 0) {
+		mutex_unlock(&class[c].lock);
+		return 0;
+	}
+	o = s->free;
+	s->free = *(char **)o;
+	if (--s->nfree == 0) {
+		class[c].partial = s->next;
+		if (s->next)
+			s->next->prev = 0;
+	}
+	class[c].inuse++;
+	mutex_unlock(&class[c].lock);
+	return o;
+}
+
+void free(void *ap) {
+	struct page *s;
+	int c;
+
+	if (ap == 0)
+		return;
+	s = (struct page *)((uint)ap & ~(PGSIZE - 1));
+	if (s->kind == LARGE) {
+		mutex_lock(&pool.lock);
+		pool.large -= s->npages;
+		pagefree(s, s->npages);
+		mutex_unlock(&pool.lock);
+		return;
+	}
+
+	c = s->kind;
+	mutex_lock(&class[c].lock);
+	*(char **)ap = s->free;
+	s->free = ap;
+	class[c].inuse--;
+	if (s->nfree++ == 0) {
+		s->prev = 0;
+		s->next = class[c].partial;
+		if (s->next)
+			s->next->prev = s;
+		class[c].partial = s;
+	}
+	// Give an empty slab back unless it is the class's only one.
+	if (s->nfree == (PGSIZE - HDRSIZE) / classsize[c] &&
+	    (s->prev || s->next)) {
+		if (s->prev)
+			s->prev->next = s->next;
+		else
+			class[c].partial = s->next;
+		if (s->next)
+			s->next->prev = s->prev;
+		class[c].nslabs--;
+		mutex_lock(&pool.lock);
+		pagefree(s, 1);
+		mutex_unlock(&pool.lock);
+	}
+	mutex_unlock(&class[c].lock);
+}
+
+// Fill in a snapshot of the heap's use.
+void heapstat(struct heapstat *st) {
+	uint c;
+
+	st->small = st->slabs = 0;
+	for (c = 0; c < NCLASS; c++) {
+		mutex_lock(&class[c].lock);
+		st->small += class[c].inuse * classsize[c];
+		st->slabs += class[c].nslabs * PGSIZE;
+		mutex_unlock(&class[c].lock);
 	}
+	mutex_lock(&pool.lock);
+	st->heap = pool.heap;
+	st->large = pool.large * PGSIZE;
+	st->free = pool.free_pages * PGSIZE;
+	mutex_unlock(&pool.lock);
 }
@@ -117,11 +117,14 @@ void drawString(window *win, char *str, RGBA color, int x, int y, int width,
 	int offset_y = 0;
 
 	while (*str != '\0') {
-		if (offset_y + CHARACTER_HEIGHT > height)
+		if (offset_y + CHARACTER_HEIGHT > height ||
+		    y + offset_y >= win->height)
 			break;
 
 		if (*str != '\n') {
-			if (offset_x + CHARACTER_WIDTH <= width) {
+			// rows above the window only advance the pen
+			if (offset_x + CHARACTER_WIDTH <= width &&
+			    y + offset_y + CHARACTER_HEIGHT > 0) {
 				drawCharacter(win->window_buf, x + offset_x,
 					      y + offset_y, *str, color,
 					      win->width, win->height);
@@ -112,97 +112,238 @@ int addScrollBarWidget(window *window, RGBA color, Handler scrollBarHandler) {
 				  scrollBarHandler);
 }
 
+// Row of f holding offset off: the last row starting at or before it.
+static int inputFieldRow(InputField *f, int off) {
+	int lo = 0, hi = f->nrows - 1;
+
+	while (lo < hi) {
+		int mid = (lo + hi + 1) / 2;
+		if (f->rowstart[mid] <= off)
+			lo = mid;
+		else
+			hi = mid - 1;
+	}
+	return lo;
+}
+
+// Rebuild the row index of f from the row holding offset from. Rows
+// before it cannot change, since a row ends either at a newline or
+// after rowcols characters, the same way drawString wraps.
+static void inputFieldReflow(InputField *f, int from) {
+	int r = inputFieldRow(f, from);
+	int i;
+
+	for (i = f->rowstart[r]; f->text[i]; i++) {
+		if (f->text[i] == '\n' || i + 1 - f->rowstart[r] >= f->rowcols)
+			f->rowstart[++r] = i + 1;
+	}
+	f->nrows = r + 1;
+	f->rowlen = i;
+}
+
+// Replace the text of f and put the cursor at its end. Apps must go
+// through here rather than writing f->text, so the row index is
+// rebuilt even when the new text has the old one's length.
+void inputFieldSetText(InputField *f, char *text) {
+	int n = strlen(text);
+
+	if (n > MAX_LONG_STRLEN - 1)
+		n = MAX_LONG_STRLEN - 1;
+	memmove(f->text, text, n);
+	f->text[n] = '\0';
+	f->current_pos = n;
+	f->rowcols = 0;
+}
+
+// Number of rows f takes when wrapped at width pixels.
+int inputFieldRows(InputField *f, int width) {
+	int cols = width / CHARACTER_WIDTH;
+
+	if (cols < 1)
+		cols = 1;
+	if (cols != f->rowcols || strlen(f->text) != f->rowlen) {
+		f->rowcols = cols;
+		f->nrows = 1;
+		f->rowstart[0] = 0;
+		inputFieldReflow(f, 0);
+	}
+	return f->nrows;
+}
+
+// Row of the text cursor of f; its column goes in *col.
+int inputFieldCursor(InputField *f, int width, int *col) {
+	int r;
+
+	inputFieldRows(f, width);
+	r = inputFieldRow(f, f->current_pos);
+	*col = f->current_pos - f->rowstart[r];
+	return r;
+}
+
+// Offset of the character cell at column x of row y, clamped to the
+// end of that row.
+static int inputFieldOffset(InputField *f, int x, int y) {
+	int start, end;
+
+	if (y < 0)
+		return 0;
+	if (y >= f->nrows)
+		return f->rowlen;
+	start = f->rowstart[y];
+	end = y + 1 < f->nrows ? f->rowstart[y + 1] - 1 : f->rowlen;
+	if (x < 0)
+		x = 0;
+	return start + x < end ? start + x : end;
+}
+
 // change text cursor from mouse click
 void inputMouseLeftClickHandler(Widget *w, message *msg) {
 	if (msg->msg_type != M_MOUSE_LEFT_CLICK)
 		return;
 
+	InputField *f = w->context.inputfield;
 	int mouse_x = msg->params[0];
 	int mouse_y = msg->params[1];
 	int width = w->position.xmax - w->position.xmin;
 
 	int mouse_char_y = (mouse_y - w->position.ymin) / CHARACTER_HEIGHT;
 	int mouse_char_x = (mouse_x - w->position.xmin) / CHARACTER_WIDTH;
-	int new_pos = getInputOffsetFromMousePosition(
-		w->context.inputfield->text, width, mouse_char_x, mouse_char_y);
 
-	w->context.inputfield->current_pos = new_pos;
+	inputFieldRows(f, width);
+	f->current_pos = inputFieldOffset(f, mouse_char_x, mouse_char_y);
 }
 
 void inputFieldKeyHandler(Widget *w, message *msg) {
 	if (msg->msg_type != M_KEY_DOWN)
 		return;
+
+	InputField *f = w->context.inputfield;
 	int width = w->position.xmax - w->position.xmin;
-	;
-	int charCount = strlen(w->context.inputfield->text);
+	int charCount = strlen(f->text);
 	int newChar = msg->params[0];
+	int x, y;
+
+	inputFieldRows(f, width);
 
 	// currently supported ASCII characters
-	if ((newChar >= ' ' && newChar <= '~') || newChar == '\n') {
-		char temp[MAX_LONG_STRLEN];
-		strcpy(temp, w->context.inputfield->text +
-				     w->context.inputfield->current_pos);
-		w->context.inputfield
-			->text[w->context.inputfield->current_pos++] = newChar;
-		strcpy(w->context.inputfield->text +
-			       w->context.inputfield->current_pos,
-		       temp);
+	if (((newChar >= ' ' && newChar <= '~') || newChar == '\n') &&
+	    charCount < MAX_LONG_STRLEN - 1) {
+		memmove(f->text + f->current_pos + 1, f->text + f->current_pos,
+			charCount - f->current_pos + 1);
+		f->text[f->current_pos] = newChar;
+		inputFieldReflow(f, f->current_pos++);
+		charCount++;
 	}
 	// handle arrow keys to change text cursor (both main keyboard and
 	// numpad) Left arrow: KEY_LF or numpad 4
 	if ((newChar == KEY_LF || newChar == KEY_KP_4 || newChar == '4') &&
-	    w->context.inputfield->current_pos > 0) {
-		w->context.inputfield->current_pos--;
+	    f->current_pos > 0) {
+		f->current_pos--;
 	}
 	// Right arrow: KEY_RT or numpad 6
 	if ((newChar == KEY_RT || newChar == KEY_KP_6 || newChar == '6') &&
-	    w->context.inputfield->current_pos < charCount) {
-		w->context.inputfield->current_pos++;
+	    f->current_pos < charCount) {
+		f->current_pos++;
 	}
 
-	int current_pos_mouse_X =
-		getMouseXFromOffset(w->context.inputfield->text, width,
-				    w->context.inputfield->current_pos);
-	int current_pos_mouse_Y =
-		getMouseYFromOffset(w->context.inputfield->text, width,
-				    w->context.inputfield->current_pos);
+	y = inputFieldRow(f, f->current_pos);
+	x = f->current_pos - f->rowstart[y];
 	// Up arrow: KEY_UP or numpad 8
 	if (newChar == KEY_UP || newChar == KEY_KP_8 || newChar == '8') {
-		w->context.inputfield->current_pos =
-			getInputOffsetFromMousePosition(
-				w->context.inputfield->text, width,
-				current_pos_mouse_X, current_pos_mouse_Y - 1);
+		f->current_pos = inputFieldOffset(f, x, y - 1);
 	}
 	// Down arrow: KEY_DN or numpad 2
 	if (newChar == KEY_DN || newChar == KEY_KP_2 || newChar == '2') {
-		w->context.inputfield->current_pos =
-			getInputOffsetFromMousePosition(
-				w->context.inputfield->text, width,
-				current_pos_mouse_X, current_pos_mouse_Y + 1);
+		f->current_pos = inputFieldOffset(f, x, y + 1);
 	}
 
 	// Home/End keys
 	if (newChar == KEY_HOME || newChar == KEY_KP_7) {
-		w->context.inputfield->current_pos =
-			getInputOffsetFromMousePosition(
-				w->context.inputfield->text, width, 0,
-				current_pos_mouse_Y);
+		f->current_pos = inputFieldOffset(f, 0, y);
 	}
 	if (newChar == KEY_END || newChar == KEY_KP_1) {
-		w->context.inputfield->current_pos =
-			getInputOffsetFromMousePosition(
-				w->context.inputfield->text, width,
-				width / CHARACTER_WIDTH, current_pos_mouse_Y);
+		f->current_pos = inputFieldOffset(f, f->rowcols, y);
 	}
 
 	// handle delete key
-	if (newChar == '\b' && w->context.inputfield->current_pos > 0) {
-		char temp[MAX_LONG_STRLEN];
-		strcpy(temp, w->context.inputfield->text +
-				     w->context.inputfield->current_pos);
-		strcpy(w->context.inputfield->text +
-			       w->context.inputfield->current_pos - 1,
-		       temp);
-		w->context.inputfield->current_pos--;
+	if (newChar == '\b' && f->current_pos > 0) {
+		f->current_pos--;
+		memmove(f->text + f->current_pos, f->text + f->current_pos + 1,
+			charCount - f->current_pos);
+		inputFieldReflow(f, f->current_pos);
+	}
+}
+
+// Move the cursor of t to column col of line, or to the end of the
+// line if it is shorter.
+static void textAreaGoto(TextArea *t, int line, int col) {
+	int n = tbnlines(&t->tb);
+
+	if (line < 0)
+		line = 0;
+	if (line >= n)
+		line = n - 1;
+	if (col > tblinelen(&t->tb, line))
+		col = tblinelen(&t->tb, line);
+	t->current_pos = tblinestart(&t->tb, line) + col;
+}
+
+// place the text cursor at the character under the mouse
+void textAreaClickHandler(Widget *w, message *msg) {
+	if (msg->msg_type != M_MOUSE_LEFT_CLICK)
+		return;
+
+	TextArea *t = w->context.textarea;
+	int row = (msg->params[1] - w->position.ymin) / CHARACTER_HEIGHT;
+	int col = (msg->params[0] - w->position.xmin) / CHARACTER_WIDTH;
+
+	if (row < 0)
+		row = 0;
+	if (col < 0)
+		col = 0;
+	textAreaGoto(t, t->top + row, t->left + col);
+}
+
+void textAreaKeyHandler(Widget *w, message *msg) {
+	if (msg->msg_type != M_KEY_DOWN)
+		return;
+
+	TextArea *t = w->context.textarea;
+	int key = msg->params[0];
+	int pos = t->current_pos;
+	int line = tblineof(&t->tb, pos);
+	int col = pos - tblinestart(&t->tb, line);
+	int rows = (w->position.ymax - w->position.ymin) / CHARACTER_HEIGHT;
+	char c = key;
+
+	if ((key >= ' ' && key <= '~') || key == '\n') {
+		if (tbinsert(&t->tb, pos, &c, 1) == 0)
+			t->current_pos++;
+	} else if (key == '\b' && pos > 0) {
+		tbdelete(&t->tb, pos - 1);
+		t->current_pos--;
+	} else if (key == KEY_DEL) {
+		tbdelete(&t->tb, pos);
+	} else if ((key == KEY_LF || key == KEY_KP_4) && pos > 0) {
+		t->current_pos--;
+	} else if ((key == KEY_RT || key == KEY_KP_6) &&
+		   pos < tblen(&t->tb)) {
+		t->current_pos++;
+	} else if (key == KEY_UP || key == KEY_KP_8) {
+		textAreaGoto(t, line - 1, line > 0 ? col : 0);
+	} else if (key == KEY_DN || key == KEY_KP_2) {
+		if (line + 1 < tbnlines(&t->tb))
+			textAreaGoto(t, line + 1, col);
+		else
+			t->current_pos = tblen(&t->tb);
+	} else if (key == KEY_HOME || key == KEY_KP_7) {
+		t->current_pos = tblinestart(&t->tb, line);
+	} else if (key == KEY_END || key == KEY_KP_1) {
+		t->current_pos =
+			tblinestart(&t->tb, line) + tblinelen(&t->tb, line);
+	} else if (key == KEY_PGUP || key == KEY_KP_9) {
+		textAreaGoto(t, line - rows, col);
+	} else if (key == KEY_PGDN || key == KEY_KP_3) {
+		textAreaGoto(t, line + rows, col);
 	}
 }
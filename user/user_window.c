@@ -12,6 +12,7 @@ void drawColorFillWidget(window *win, Widget *w);
 void drawButtonWidget(window *win, Widget *w);
 void drawTextWidget(window *win, Widget *w);
 void drawInputFieldWidget(window *win, Widget *w);
+void drawTextAreaWidget(window *win, Widget *w);
 void drawShapeWidget(window *win, Widget *w);
 int freeWidget(window *win, int index);
 
@@ -156,6 +157,9 @@ void repaintWindow(window *win) {
 			case INPUTFIELD:
 				drawInputFieldWidget(win, &win->widgets[p]);
 				break;
+			case TEXTAREA:
+				drawTextAreaWidget(win, &win->widgets[p]);
+				break;
 			case SHAPE:
 				drawShapeWidget(win, &win->widgets[p]);
 				break;
@@ -227,7 +231,8 @@ void updateWindow(window *win) {
 					}
 
 					if (win->widgets[p].type ==
-					    INPUTFIELD) {
+						    INPUTFIELD ||
+					    win->widgets[p].type == TEXTAREA) {
 						win->keyfocus = p;
 					}
 
@@ -369,6 +374,10 @@ int freeWidget(window *win, int index) {
 	case INPUTFIELD:
 		free(win->widgets[index].context.inputfield);
 		break;
+	case TEXTAREA:
+		tbfree(&win->widgets[index].context.textarea->tb);
+		free(win->widgets[index].context.textarea);
+		break;
 
 	default:
 		break;
@@ -486,8 +495,7 @@ int addInputFieldWidget(window *win, RGBA c, char *text, int x, int y, int w,
 		return -1;
 	InputField *t = malloc(sizeof(InputField));
 	t->color = c;
-	strcpy(t->text, text);
-	t->current_pos = strlen(text);
+	inputFieldSetText(t, text);
 
 	Widget *widget = &win->widgets[widgetId];
 	widget->context.inputfield = t;
@@ -501,6 +509,38 @@ int addInputFieldWidget(window *win, RGBA c, char *text, int x, int y, int w,
 	return widgetId;
 }
 
+int addTextAreaWidget(window *win, RGBA c, int x, int y, int w, int h,
+		      int scrollable, Handler handler) {
+
+	TextArea *t = malloc(sizeof(TextArea));
+	if (t == 0)
+		return -1;
+	if (tbinit(&t->tb) < 0) {
+		free(t);
+		return -1;
+	}
+	int widgetId = addWidget(win);
+	if (widgetId == -1) {
+		tbfree(&t->tb);
+		free(t);
+		return -1;
+	}
+	t->color = c;
+	t->current_pos = 0;
+	t->top = t->left = 0;
+
+	Widget *widget = &win->widgets[widgetId];
+	widget->context.textarea = t;
+	widget->type = TEXTAREA;
+	widget->handler = handler;
+	widget->scrollable = scrollable;
+	setWidgetSize(widget, x, y, w, h);
+
+	win->keyfocus = widgetId;
+
+	return widgetId;
+}
+
 void drawColorFillWidget(window *win, Widget *w) {
 	int width = w->position.xmax - w->position.xmin;
 	int height = w->position.ymax - w->position.ymin;
@@ -581,28 +621,35 @@ void drawInputFieldWidget(window *win, Widget *w) {
 	int width = w->position.xmax - w->position.xmin;
 	int height = w->position.ymax - w->position.ymin;
 
-	drawString(win, w->context.inputfield->text,
-		   w->context.inputfield->color, xmin, ymin, width, height);
-
-	// draw the text cursor
-	int offset_x = 0;
-	int offset_y = 0;
-	int iter = 0;
-	while (iter < w->context.inputfield->current_pos) {
-		if (offset_y > height)
-			break;
-		if (w->context.inputfield->text[iter] != '\n') {
-			offset_x += CHARACTER_WIDTH;
-			if (offset_x > width) {
-				offset_x = 0;
-				offset_y += CHARACTER_HEIGHT;
-			}
-		} else {
-			offset_x = 0;
-			offset_y += CHARACTER_HEIGHT;
+	InputField *f = w->context.inputfield;
+	int rows = inputFieldRows(f, width);
+	int first = ymin < 0 ? -ymin / CHARACTER_HEIGHT : 0;
+	int last = height / CHARACTER_HEIGHT;
+	int bottom = (win->height - ymin + CHARACTER_HEIGHT - 1) /
+		     CHARACTER_HEIGHT;
+
+	// draw only the rows inside both the widget and the window
+	if (last > rows)
+		last = rows;
+	if (last > bottom)
+		last = bottom;
+	for (int r = first; r < last; r++) {
+		int end = r + 1 < rows ? f->rowstart[r + 1] : f->rowlen;
+		int x = xmin;
+		for (int i = f->rowstart[r]; i < end; i++) {
+			if (f->text[i] == '\n')
+				break;
+			drawCharacter(win->window_buf, x,
+				      ymin + r * CHARACTER_HEIGHT, f->text[i],
+				      f->color, win->width, win->height);
+			x += CHARACTER_WIDTH;
 		}
-		iter++;
 	}
+
+	// draw the text cursor
+	int col;
+	int offset_y = inputFieldCursor(f, width, &col) * CHARACTER_HEIGHT;
+	int offset_x = col * CHARACTER_WIDTH;
 	RGBA black;
 	black.R = 0;
 	black.G = 0;
@@ -613,4 +660,65 @@ void drawInputFieldWidget(window *win, Widget *w) {
 		drawFillRect(win, black, xmin + offset_x, ymin + offset_y + 1,
 			     1, CHARACTER_HEIGHT - 4);
 	}
+}
+
+// Scroll t so that the cursor is within rows by cols cells.
+static void textAreaShow(TextArea *t, int rows, int cols) {
+	int line = tblineof(&t->tb, t->current_pos);
+	int col = t->current_pos - tblinestart(&t->tb, line);
+
+	if (line < t->top)
+		t->top = line;
+	if (rows > 0 && line >= t->top + rows)
+		t->top = line - rows + 1;
+	if (col < t->left)
+		t->left = col;
+	if (cols > 0 && col >= t->left + cols)
+		t->left = col - cols + 1;
+}
+
+// Only the lines in view are visited; each is found through the
+// buffer's line index.
+void drawTextAreaWidget(window *win, Widget *w) {
+	TextArea *t = w->context.textarea;
+	int xmin = w->position.xmin, ymin = w->position.ymin;
+	if (w->scrollable) {
+		xmin = w->position.xmin - win->scrollOffsetX;
+		ymin = w->position.ymin - win->scrollOffsetY;
+	}
+	int width = w->position.xmax - w->position.xmin;
+	int height = w->position.ymax - w->position.ymin;
+	int rows = height / CHARACTER_HEIGHT;
+	int cols = width / CHARACTER_WIDTH;
+	int line, start, len, row, i;
+
+	textAreaShow(t, rows, cols);
+	for (row = 0; row < rows; row++) {
+		line = t->top + row;
+		if (line >= tbnlines(&t->tb))
+			break;
+		start = tblinestart(&t->tb, line);
+		len = tblinelen(&t->tb, line);
+		for (i = t->left; i < len && i < t->left + cols; i++)
+			drawCharacter(win->window_buf,
+				      xmin + (i - t->left) * CHARACTER_WIDTH,
+				      ymin + row * CHARACTER_HEIGHT,
+				      tbchar(&t->tb, start + i), t->color,
+				      win->width, win->height);
+	}
+
+	// draw the text cursor
+	line = tblineof(&t->tb, t->current_pos);
+	i = t->current_pos - tblinestart(&t->tb, line);
+	RGBA black;
+	black.R = 0;
+	black.G = 0;
+	black.B = 0;
+	black.A = 255;
+
+	if (line - t->top < rows)
+		drawFillRect(win, black,
+			     xmin + (i - t->left) * CHARACTER_WIDTH,
+			     ymin + (line - t->top) * CHARACTER_HEIGHT + 1, 1,
+			     CHARACTER_HEIGHT - 4);
 }
\ No newline at end of file